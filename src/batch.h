@@ -0,0 +1,541 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+// Offline referee for a batch of games played in lockstep, stored structure-of-arrays.
+//
+// It must be included right after simulator.h. The rules are those of Simulator, game
+// for game: BatchSimulator(seed, n) plays the very same games as Simulator(seed + g) for
+// g < n, given the same orders.
+//
+// The state of entity e in game g is at [e * n + g], so that the updates of a turn (the
+// moves of the heros and the monsters, the attacks, the captures by the bases and the
+// hits on them) are branch-free loops over the games, which the compiler vectorizes.
+// The spells stay game by game: they are rare, and the order they are cast in matters.
+//
+// A monster keeps its slot for the whole game: its id - kFirstMonsterId (the ids are
+// never reused, and a game spawns kMaxMonsters of them at most). The slots before
+// m_first are dead in every game and the ones from m_spawned on are not born yet.
+//
+// The range checks of the referee compare float lengths (distance()) with a radius. As
+// that length never decreases with the squared distance, each of them is the exact
+// comparison of a squared distance with a threshold computed once (range_threshold()).
+//
+// A game that is over keeps being played along with the others (it would only cost
+// masks), but its result is frozen at its last turn.
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// the largest squared distance d2 such that the length of the referee (float) is at most r
+int range_threshold(int r) {
+    int d2 = r * r;
+    while ((float) std::sqrt((double) d2 + 1) <= r) ++d2;
+    return d2;
+}
+
+const int kAttackRange2 = range_threshold(kHeroPhysicAttackRange);
+const int kWindRange2 = range_threshold(kRadiusOfWind);
+const int kSpellRange2 = range_threshold(kSpellRange);
+const int kBaseRadius2 = range_threshold(kRadiusOfBase);
+const int kBaseHit2 = range_threshold(kBaseAttackRange);
+const int kMonsterStep2 = range_threshold(kMonsterSpeed);
+const int kHeroStep2 = range_threshold(kHeroSpeed);
+const int kHeroView2 = range_threshold(kHeroViewRange);
+const int kBaseView2 = range_threshold(kBaseViewRange);
+
+// a if c (0 or 1), else b: plain arithmetic, which GCC if-converts where it gives up on ?:
+inline int pick(int c, int a, int b) {
+    return b ^ ((a ^ b) & -c);
+}
+
+// the step of scale_toward() on plain integers: the same float arithmetic, so the same result
+inline int scaled_step(int d, float dist, int len) {
+    // computed either way (no branch)
+    int step = (int) (d * len / (dist + (dist == 0)));
+    return step & -(dist != 0);
+}
+
+inline float referee_length(int dx, int dy) {
+    return (float) std::sqrt((double) dx * dx + (double) dy * dy);
+}
+
+// The kernels of a turn, over the games of one monster slot. Their arrays never overlap,
+// which lets the compiler vectorize them.
+
+// the attacks of a hero (of the player whose base is at b)
+void batch_attack(int n, Point b, const int * __restrict hx, const int * __restrict hy,
+                  const int * __restrict x, const int * __restrict y, const int * __restrict alive,
+                  int * __restrict hp, int * __restrict mp, int * __restrict wild) {
+    for (int g = 0; g < n; ++g) {
+        int dx = hx[g] - x[g], dy = hy[g] - y[g];
+        int ex = x[g] - b.x, ey = y[g] - b.y;
+        int hit = alive[g] & (dx * dx + dy * dy <= kAttackRange2);
+        int outside = ex * ex + ey * ey > kBaseRadius2;
+        hp[g] -= hit * kHeroPhysicAttackDmg;
+        mp[g] += hit * kManaPerHit;
+        wild[g] += (hit & outside) * kManaPerHit;
+    }
+}
+
+// the moves of the monsters (as Simulator::move_monsters()); hp0 and hp1 are those of the bases
+void batch_move(int n, int * __restrict x, int * __restrict y, int * __restrict vx, int * __restrict vy,
+                int * __restrict target, int * __restrict threat, int * __restrict alive,
+                const int * __restrict life, const int * __restrict mad, const int * __restrict pushed,
+                int * __restrict hp0, int * __restrict hp1) {
+    for (int g = 0; g < n; ++g) {
+        // everything is loaded and stored once, whatever the case (no branch)
+        int px = x[g], py = y[g], pvx = vx[g], pvy = vy[g], targeted = target[g] != 0;
+        int live = alive[g] & (life[g] > 0);
+        int still = pushed[g] == 0;
+
+        // heading for a base
+        int second = threat[g] == 2;
+        int bx = kWidth & -second;
+        int by = kHeight & -second;
+        int dx = bx - px, dy = by - py;
+        int arrive = dx * dx + dy * dy <= kMonsterStep2;
+        float dist = referee_length(dx, dy);
+        int ax = pick(arrive, bx, px + scaled_step(dx, dist, kMonsterSpeed));
+        int ay = pick(arrive, by, py + scaled_step(dy, dist, kMonsterSpeed));
+        int heading = live & targeted & still;
+        int hx = ax - bx, hy = ay - by;
+        int hit = heading & (hx * hx + hy * hy <= kBaseHit2);
+        hp0[g] -= hit & (second ^ 1);
+        hp1[g] -= hit & second;
+
+        // or walking its line
+        int walking = live & (targeted ^ 1) & still;
+        int nx = pick(heading, ax, px + (pvx & -walking));
+        int ny = pick(heading, ay, py + (pvy & -walking));
+        int valid = (nx >= 0) & (ny >= 0) & (nx <= kWidth) & (ny <= kHeight);
+        live = live & (hit ^ 1) & valid;
+
+        // out of the radius of its base: free again
+        int ox = nx - bx, oy = ny - by;
+        int kept = targeted & (ox * ox + oy * oy <= kBaseRadius2);
+
+        // captured by a base (ours first)
+        int fx = kWidth - nx, fy = kHeight - ny;
+        int in0 = nx * nx + ny * ny <= kBaseRadius2;
+        int in1 = fx * fx + fy * fy <= kBaseRadius2;
+        int capture = (kept ^ 1) & (mad[g] == 0) & (in0 | in1);
+        int ex = pick(in0, -nx, fx), ey = pick(in0, -ny, fy);
+        float cdist = referee_length(ex, ey);
+
+        x[g] = nx;
+        y[g] = ny;
+        vx[g] = pick(capture, scaled_step(ex, cdist, kMonsterSpeed), pvx);
+        vy[g] = pick(capture, scaled_step(ey, cdist, kMonsterSpeed), pvy);
+        target[g] = capture | kept;
+        threat[g] = pick(capture, 2 - in0, threat[g]);
+        alive[g] = live;
+    }
+}
+
+class BatchSimulator {
+public:
+    static constexpr int kMaxMonsters = 2 * ((kMaxTurns - 1) / kSpawnPeriod + 1);
+    static constexpr int kHeros = 2 * kHerosPerPlayer; // by id
+
+    BatchSimulator(uint64_t seed, int games) :
+        m_n(games), m_turns(0), m_first(0), m_spawned(0)
+    {
+        auto sized = [&](vector<int> & v, int entities) { v.assign(entities * m_n, 0); };
+        for (auto * v : { &m_mx, &m_my, &m_mvx, &m_mvy, &m_mhp, &m_mshield, &m_mtarget, &m_mthreat,
+                          &m_mmad, &m_alive, &m_pushed }) {
+            sized(*v, kMaxMonsters);
+        }
+        for (auto * v : { &m_hx, &m_hy, &m_hshield, &m_hmad, &m_controlled, &m_forcedX, &m_forcedY,
+                          &m_verb, &m_object, &m_destX, &m_destY }) {
+            sized(*v, kHeros);
+        }
+        for (auto * v : { &m_hp, &m_mp, &m_wild, &m_finalHp, &m_finalMp, &m_finalWild }) {
+            sized(*v, 2);
+        }
+        m_end.assign(m_n, 0);
+        for (int g = 0; g < m_n; ++g) {
+            m_rng.emplace_back(seed + g);
+        }
+
+        // as Simulator::reset()
+        const Point offsets[kHerosPerPlayer] = { Point(1414, 849), Point(1131, 1131), Point(849, 1414) };
+        for (int h = 0; h < kHeros; ++h) {
+            int p = h / kHerosPerPlayer;
+            Point pos = p == 0 ? offsets[h % kHerosPerPlayer] : base_pos(1) - offsets[h % kHerosPerPlayer];
+            for (int g = 0; g < m_n; ++g) {
+                m_hx[h * m_n + g] = pos.x;
+                m_hy[h * m_n + g] = pos.y;
+            }
+        }
+        for (int i = 0; i < 2 * m_n; ++i) {
+            m_hp[i] = kBaseHp;
+        }
+    }
+
+    int games() const { return m_n; }
+    int turns() const { return m_turns; }
+
+    // all the games
+    bool over() const { return m_turns >= kMaxTurns; }
+
+    bool over(int g) const { return m_end[g] != 0; }
+
+    // the turns of a game (so far, or in all)
+    int turns(int g) const { return over(g) ? m_end[g] : m_turns; }
+
+    Base base(int g, int player) const {
+        Base b;
+        b.pos = base_pos(player);
+        int i = player * m_n + g;
+        if (over(g)) {
+            b.update(m_finalHp[i], m_finalMp[i]);
+        } else {
+            b.update(m_hp[i], m_mp[i]);
+        }
+        return b;
+    }
+
+    int wildMana(int g, int player) const {
+        int i = player * m_n + g;
+        return over(g) ? m_finalWild[i] : m_wild[i];
+    }
+
+    // 0 or 1 for the winner, -1 for a draw (as Simulator::winner())
+    int winner(int g) const {
+        int hp[2] = { base(g, 0).hp, base(g, 1).hp };
+        if (hp[0] != hp[1]) return hp[0] > hp[1] ? 0 : 1;
+        int wild[2] = { wildMana(g, 0), wildMana(g, 1) };
+        if (wild[0] != wild[1]) return wild[0] > wild[1] ? 0 : 1;
+        return -1;
+    }
+
+    // what the given player sees in a game (as Simulator::observe())
+    void observe(int g, int player, vector<Entity> & units) const {
+        units.clear();
+        for (int h = 0; h < kHeros; ++h) {
+            int owner = h / kHerosPerPlayer;
+            int i = h * m_n + g;
+            if (owner != player && !visible(g, player, m_hx[i], m_hy[i])) continue;
+
+            Entity e = {};
+            e.id = h;
+            e.type = owner == player ? 1 : 2;
+            e.pos = Point(m_hx[i], m_hy[i]);
+            e.shield = m_hshield[i];
+            e.mad = m_hmad[i] != 0;
+            units.push_back(e);
+        }
+        for (int s = m_first; s < m_spawned; ++s) {
+            int i = s * m_n + g;
+            if (!m_alive[i] || !visible(g, player, m_mx[i], m_my[i])) continue;
+
+            units.push_back(monster(s, g));
+            auto & e = units.back();
+            if (player == 1 && e.threat != 0) e.threat = 3 - e.threat;
+        }
+    }
+
+    void order(int g, int player, int idx, const Action & a) {
+        int i = (player * kHerosPerPlayer + idx) * m_n + g;
+        m_verb[i] = a.verb;
+        m_object[i] = a.object;
+        m_destX[i] = a.dest.x;
+        m_destY[i] = a.dest.y;
+    }
+
+    void order(int g, int player, const TurnOutput & output) {
+        for (int idx = 0; idx < output.count; ++idx) {
+            Action a;
+            a.verb = output.orders[idx].verb;
+            a.object = output.orders[idx].object;
+            a.dest = output.orders[idx].dest;
+            order(g, player, idx, a);
+        }
+    }
+
+    // resolve one turn of every game
+    void step() {
+        ++m_turns;
+
+        // controlled heros follow the orders of the opponent
+        const int n = m_n;
+        for (int i = 0; i < kHeros * n; ++i) {
+            bool forced = m_controlled[i] != 0;
+            m_verb[i] = forced ? MOVE : m_verb[i];
+            m_destX[i] = forced ? m_forcedX[i] : m_destX[i];
+            m_destY[i] = forced ? m_forcedY[i] : m_destY[i];
+            m_controlled[i] = 0;
+        }
+        std::fill(m_pushed.begin() + m_first * m_n, m_pushed.begin() + m_spawned * m_n, 0);
+
+        for (int g = 0; g < m_n; ++g) {
+            cast_spells(g);
+        }
+        move_heros();
+        attack_monsters();
+        move_monsters();
+        expire_effects();
+        spawn_monsters();
+        update_threats();
+
+        std::fill(m_verb.begin(), m_verb.end(), (int) WAIT);
+        freeze_results();
+    }
+
+private:
+    static Point base_pos(int player) {
+        return player == 0 ? Point(0, 0) : Point(kWidth, kHeight);
+    }
+
+    static int square_distance(int x, int y, int u, int v) {
+        return (x - u) * (x - u) + (y - v) * (y - v);
+    }
+
+    Entity monster(int s, int g) const {
+        int i = s * m_n + g;
+        Entity e = {};
+        e.id = kFirstMonsterId + s;
+        e.type = 0;
+        e.pos = Point(m_mx[i], m_my[i]);
+        e.shield = m_mshield[i];
+        e.mad = m_mmad[i] != 0;
+        e.hp = m_mhp[i];
+        e.v = Point(m_mvx[i], m_mvy[i]);
+        e.target = m_mtarget[i];
+        e.threat = m_mthreat[i];
+        return e;
+    }
+
+    bool visible(int g, int player, int x, int y) const {
+        Point b = base_pos(player);
+        if (square_distance(x, y, b.x, b.y) <= kBaseView2) return true;
+        for (int h = player * kHerosPerPlayer; h < (player + 1) * kHerosPerPlayer; ++h) {
+            int i = h * m_n + g;
+            if (square_distance(x, y, m_hx[i], m_hy[i]) <= kHeroView2) return true;
+        }
+        return false;
+    }
+
+    // game by game, in the order of Simulator::cast_spells()
+    void cast_spells(int g) {
+        for (int h = 0; h < kHeros; ++h) {
+            int i = h * m_n + g;
+            int verb = m_verb[i];
+            if (verb != WIND && verb != PROTECT && verb != CONTROL) continue;
+
+            int p = h / kHerosPerPlayer;
+            int & mp = m_mp[p * m_n + g];
+            if (mp < kMagicManaCost) {
+                m_verb[i] = WAIT;
+                continue;
+            }
+            mp -= kMagicManaCost;
+
+            Point caster(m_hx[i], m_hy[i]);
+            Point dest(m_destX[i], m_destY[i]);
+            if (verb == WIND) {
+                blow(g, p, caster, dest);
+                continue;
+            }
+
+            // the target: a hero or a monster alive
+            int id = m_object[i];
+            int t = -1;
+            bool isHero = id >= 0 && id < kFirstMonsterId;
+            if (isHero) {
+                t = id * m_n + g;
+            } else if (id >= kFirstMonsterId && id - kFirstMonsterId < m_spawned) {
+                t = (id - kFirstMonsterId) * m_n + g;
+                if (!m_alive[t]) t = -1;
+            }
+            if (t < 0) continue;
+            int & shield = isHero ? m_hshield[t] : m_mshield[t];
+            int tx = isHero ? m_hx[t] : m_mx[t];
+            int ty = isHero ? m_hy[t] : m_my[t];
+            if (shield > 0) continue;
+            if (square_distance(caster.x, caster.y, tx, ty) > kSpellRange2) continue;
+
+            if (verb == PROTECT) {
+                shield = kShieldDuration;
+            } else if (!isHero) {
+                Point v = scale_toward(Point(tx, ty), dest, kMonsterSpeed);
+                if (v.x != 0 || v.y != 0) {
+                    m_mvx[t] = v.x;
+                    m_mvy[t] = v.y;
+                }
+                m_mtarget[t] = 0;
+                m_mmad[t] = 1;
+            } else if (id / kHerosPerPlayer != p) {
+                m_controlled[t] = 1;
+                m_forcedX[t] = dest.x;
+                m_forcedY[t] = dest.y;
+                m_hmad[t] = 1;
+            }
+        }
+    }
+
+    // push the monsters and the opponents around the caster
+    void blow(int g, int player, const Point & from, const Point & toward) {
+        Point push = scale_toward(from, toward, kWindPushDistance);
+        for (int s = m_first; s < m_spawned; ++s) {
+            int i = s * m_n + g;
+            if (!m_alive[i] || m_mshield[i] > 0) continue;
+            if (square_distance(m_mx[i], m_my[i], from.x, from.y) > kWindRange2) continue;
+
+            m_mx[i] += push.x;
+            m_my[i] += push.y;
+            m_pushed[i] = 1;
+        }
+        for (int h = 0; h < kHeros; ++h) {
+            int i = h * m_n + g;
+            if (h / kHerosPerPlayer == player || m_hshield[i] > 0) continue;
+            if (square_distance(m_hx[i], m_hy[i], from.x, from.y) > kWindRange2) continue;
+
+            Point q = clamp_to_map(Point(m_hx[i] + push.x, m_hy[i] + push.y));
+            m_hx[i] = q.x;
+            m_hy[i] = q.y;
+        }
+    }
+
+    void move_heros() {
+        const int n = m_n; // (an int store could change m_n)
+        for (int i = 0; i < kHeros * n; ++i) {
+            int x = m_hx[i], y = m_hy[i];
+            int dx = m_destX[i] - x, dy = m_destY[i] - y;
+            // the orders may point anywhere: 64 bits
+            bool arrive = (long long) dx * dx + (long long) dy * dy <= kHeroStep2;
+            float dist = referee_length(dx, dy);
+            int nx = arrive ? m_destX[i] : x + scaled_step(dx, dist, kHeroSpeed);
+            int ny = arrive ? m_destY[i] : y + scaled_step(dy, dist, kHeroSpeed);
+            bool moving = m_verb[i] == MOVE;
+            m_hx[i] = moving ? std::min(std::max(nx, 0), kWidth) : x;
+            m_hy[i] = moving ? std::min(std::max(ny, 0), kHeight) : y;
+        }
+    }
+
+    void attack_monsters() {
+        const int n = m_n;
+        for (int h = 0; h < kHeros; ++h) {
+            int p = h / kHerosPerPlayer;
+            for (int s = m_first; s < m_spawned; ++s) {
+                batch_attack(n, base_pos(p), &m_hx[h * n], &m_hy[h * n], &m_mx[s * n], &m_my[s * n],
+                             &m_alive[s * n], &m_mhp[s * n], &m_mp[p * n], &m_wild[p * n]);
+            }
+        }
+    }
+
+    void move_monsters() {
+        const int n = m_n;
+        for (int s = m_first; s < m_spawned; ++s) {
+            int i = s * n;
+            batch_move(n, &m_mx[i], &m_my[i], &m_mvx[i], &m_mvy[i], &m_mtarget[i], &m_mthreat[i], &m_alive[i],
+                       &m_mhp[i], &m_mmad[i], &m_pushed[i], &m_hp[0], &m_hp[n]);
+        }
+
+        // the slots dead in every game are left out from now on
+        while (m_first < m_spawned) {
+            const int * alive = &m_alive[m_first * n];
+            if (std::any_of(alive, alive + n, [](int a) { return a != 0; })) break;
+            ++m_first;
+        }
+    }
+
+    void expire_effects() {
+        const int n = m_n;
+        for (int i = 0; i < kHeros * n; ++i) {
+            m_hshield[i] -= m_hshield[i] > 0;
+            m_hmad[i] = m_controlled[i];
+        }
+        for (int i = m_first * n; i < m_spawned * n; ++i) {
+            m_mshield[i] -= m_mshield[i] > 0;
+            m_mmad[i] = 0;
+        }
+    }
+
+    // monsters come in symmetric pairs from the top and the bottom edges
+    void spawn_monsters() {
+        if ((m_turns - 1) % kSpawnPeriod != 0) return;
+
+        int s = m_spawned;
+        m_spawned += 2;
+        for (int g = 0; g < m_n; ++g) {
+            auto & rng = m_rng[g];
+            int x = rng.between(kWidth / 2 - kSpawnSpread, kWidth / 2 + kSpawnSpread);
+            double theta = convert_degree_to_radian(rng.between(20, 160));
+            Point v(kMonsterSpeed * std::cos(theta), kMonsterSpeed * std::sin(theta));
+            spawn(s, g, Point(x, 0), v);
+            spawn(s + 1, g, Point(kWidth - x, kHeight), Point(-v.x, -v.y));
+        }
+    }
+
+    void spawn(int s, int g, const Point & pos, const Point & v) {
+        int i = s * m_n + g;
+        m_mx[i] = pos.x;
+        m_my[i] = pos.y;
+        m_mvx[i] = v.x;
+        m_mvy[i] = v.y;
+        m_mhp[i] = kMonsterInitialHp + m_turns / 10;
+        m_mshield[i] = 0;
+        m_mtarget[i] = 0;
+        m_mthreat[i] = 0;
+        m_mmad[i] = 0;
+        m_alive[i] = 1;
+    }
+
+    // Monster::eta() is not worth vectorizing: only the free monsters need it
+    void update_threats() {
+        Base bases[2];
+        bases[0].pos = base_pos(0);
+        bases[1].pos = base_pos(1);
+        for (int i = m_first * m_n; i < m_spawned * m_n; ++i) {
+            if (!m_alive[i] || m_mtarget[i] != 0) continue;
+
+            Entity e = {};
+            e.pos = Point(m_mx[i], m_my[i]);
+            e.v = Point(m_mvx[i], m_mvy[i]);
+            Monster m(e);
+            m_mthreat[i] = m.eta(bases[0]) >= 0 ? 1 : m.eta(bases[1]) >= 0 ? 2 : 0;
+        }
+    }
+
+    // as Simulator::over(), game by game
+    void freeze_results() {
+        for (int g = 0; g < m_n; ++g) {
+            if (m_end[g] != 0) continue;
+            if (m_turns < kMaxTurns && m_hp[g] > 0 && m_hp[m_n + g] > 0) continue;
+
+            m_end[g] = m_turns;
+            for (int p = 0; p < 2; ++p) {
+                int i = p * m_n + g;
+                m_finalHp[i] = m_hp[i];
+                m_finalMp[i] = m_mp[i];
+                m_finalWild[i] = m_wild[i];
+            }
+        }
+    }
+
+    int m_n; // the games
+    int m_turns;
+    int m_first; // the first slot of a monster alive in some game
+    int m_spawned; // the slots given so far
+
+    // the monsters, [slot * m_n + game]
+    vector<int> m_mx, m_my, m_mvx, m_mvy, m_mhp, m_mshield, m_mtarget, m_mthreat, m_mmad;
+    vector<int> m_alive;
+    vector<int> m_pushed; // by a wind this turn
+
+    // the heros, [id * m_n + game]
+    vector<int> m_hx, m_hy, m_hshield, m_hmad;
+    vector<int> m_controlled, m_forcedX, m_forcedY; // by an opponent this turn
+    vector<int> m_verb, m_object, m_destX, m_destY; // their orders
+
+    // the bases, [player * m_n + game]
+    vector<int> m_hp, m_mp, m_wild;
+    vector<int> m_finalHp, m_finalMp, m_finalWild;
+
+    vector<int> m_end; // the last turn of a game (0 while it goes on)
+    vector<Rng> m_rng;
+};
+
+#endif // BATCH_H
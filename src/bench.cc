@@ -0,0 +1,939 @@
+// Micro-benchmarks of the decision kernels of Brain.
+//
+// usage: bench.out assign|cover [rounds] [budget_us]
+//        bench.out batch [games]
+//        bench.out deadline [games] [slack_us]
+//        bench.out store [turns]
+//        bench.out table [turns]
+//        bench.out index [rounds]
+//        bench.out timeline [games]
+//        bench.out lanes
+//        bench.out forecast [rounds]
+//
+// assign: the joint assignment of the defenders on random crowds of monsters around
+// our base (8 to 64 of them): intercept costs and exhaustive search, as
+// Brain::assign_defenders() does it on the forecast of the turn. Reports the latency
+// percentiles per crowd size and fails if a p99 exceeds the budget (50us by default;
+// the maximum is left out, being mostly the scheduler).
+//
+// cover: the weighted attack circles of two and three heros placed jointly on random
+// clusters of 8 to 64 monsters (JointCoverOptimiser), against its own budget (250us by
+// default).
+//
+// batch: the throughput in games per second of the referee, game by game (Simulator)
+// and in lockstep batches of 64 and 256 games (BatchSimulator), the heros being played by
+// a cheap scripted player. The time of the turns alone (step()) is reported apart from
+// the total, which includes what the players see and do. Fails if a game of a batch
+// does not end exactly as the same game on Simulator.
+//
+// deadline: self-play games of Brain under time budgets of 5us to 40ms per turn. Reports
+// the latency of step() against the budget, the turns answered by the fallback (no time
+// left to plan) and those planned more than once. Fails if a p99 exceeds its budget by
+// more than the slack (100us by default). Then turns of four times kMaxMonsters monsters
+// around our base without any budget, every pass of the plan being made: fails if one of
+// them takes longer than kTurnTime.
+//
+// store: the id table of EntityStore over long runs: three heros and two monsters living
+// a few turns each, every turn, then the units seen by both players of self-play games.
+// Fails if the table spans more ids than it reserves (its growth would allocate).
+//
+// table: the kernels of MonsterTable against the exact scalar predicates (and the straight
+// lines of step()) on random turns
+// (positions off the map included, and crowds beyond kMaxEntities). Only the path of the build is checked: build with
+// CXXFLAGS="--std=c++17 -mavx2" for AVX2, with -DBRAIN_NO_SIMD for the plain loops. Fails on
+// the first mismatch.
+//
+// index: the range queries of discover() on 64 and 256 monsters spread over the map, on
+// MonsterTable and on the uniform grid it replaced (cells of 1000). Fails if the two disagree
+// or if the table is the slower one.
+//
+// timeline: the next monster to hit the base among the ones within a radius of it (that of
+// Brain::next_to_reach_our_base()), from ThreatTimeline kept from turn to turn (a turn being
+// skipped now and then, as past the deadline) and from one rebuilt from scratch every turn,
+// against a scan of the forecast, on what the players of self-play games see. Fails on a
+// mismatch.
+//
+// lanes: the degree between two points (Direction, on integer cross-products) against the
+// original formula, the truncated atan of dy / dx in double, on every offset between two
+// points of the map; and the thresholds of the lanes and the areas against that degree.
+// Fails on a mismatch.
+//
+// forecast: MonsterForecast, whose straight lines come from MonsterTable::step(), against
+// the scalar pass it replaced, on random turns of 64 and 256 monsters (some of them heading
+// for a base, some off the map). Reports the time of both builds (the table excluded, the
+// parse building it anyway); fails if a position, an end, an entry or a hit differs.
+
+#define BRAIN_NO_MAIN
+#include "game.cc"
+#include "simulator.h"
+#include "batch.h"
+
+#include <chrono>
+#include <cstdlib>
+
+double percentile(const vector<double> & sorted, double q) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(q * sorted.size()))];
+}
+
+// monsters around our base, heading for it or passing by
+vector<Monster> random_crowd(Rng & rng, int n) {
+    vector<Monster> monsters;
+    for (int i = 0; i < n; ++i) {
+        Entity e = {};
+        e.id = kFirstMonsterId + i;
+        e.pos = Point(rng.between(0, kOutterCircle), rng.between(0, kOutterCircle));
+        e.hp = rng.between(10, 30);
+        if (within(e.pos, kOurCorner, kRadiusOfBase)) {
+            e.target = 1;
+            e.threat = 1;
+            e.v = scale_toward(e.pos, kOurCorner, kMonsterSpeed);
+        } else {
+            e.v = scale_toward(e.pos, Point(rng.between(0, kWidth), rng.between(0, kHeight)), kMonsterSpeed);
+        }
+        monsters.push_back(e);
+    }
+    return monsters;
+}
+
+int bench_assign(int rounds, double budget) {
+    Base ours;
+    Base theirs;
+    ours.pos = kOurCorner;
+    theirs.pos = kTheirCorner;
+    Rng rng(1);
+    MonsterTable table;
+    MonsterForecast forecast;
+    AssignmentSolver solver;
+    double worst = 0; // p99
+    for (int n : { 8, 16, 32, 48, 64 }) {
+        vector<double> latencies;
+        for (int r = 0; r < rounds; ++r) {
+            auto monsters = random_crowd(rng, n);
+            Point heros[kNumberOfDefenders];
+            for (auto & h : heros) h = Point(rng.between(0, kMidCircle), rng.between(0, kMidCircle));
+
+            table.build(monsters);
+            forecast.build(monsters, table, ours, theirs);
+            auto start = std::chrono::steady_clock::now();
+            solver.reset(kNumberOfDefenders, n);
+            for (int h = 0; h < kNumberOfDefenders; ++h) {
+                solver.set_idle(h, kIdleDefenderCost);
+                for (int t = 0; t < n; ++t) {
+                    int turns = forecast.intercept(t, heros[h], kHeroSpeed, kHeroPhysicAttackRange);
+                    if (turns == MonsterForecast::kNever) turns = MonsterForecast::kTurns + 1;
+                    solver.set(h, t, kInterceptTurnCost * turns - eval_risk(ours, monsters[t]));
+                }
+            }
+            solver.require(0);
+            int out[kNumberOfDefenders];
+            solver.solve(out);
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            latencies.push_back(elapsed.count());
+        }
+        sort(latencies.begin(), latencies.end());
+        worst = std::max(worst, percentile(latencies, 0.99));
+        cout << "monsters=" << n << "; p50=" << percentile(latencies, 0.5) << "us";
+        cout << "; p99=" << percentile(latencies, 0.99) << "us";
+        cout << "; max=" << latencies.back() << "us" << endl;
+    }
+    bool ok = worst <= budget;
+    cout << "budget=" << budget << "us; " << (ok ? "ok" : "exceeded") << endl;
+    return ok ? 0 : 1;
+}
+
+int bench_cover(int rounds, double budget) {
+    Rng rng(1);
+    JointCoverOptimiser cover;
+    double worst = 0; // p99
+    for (int circles : { 2, 3 }) {
+        for (int n : { 8, 16, 32, 48, 64 }) {
+            vector<double> latencies;
+            for (int r = 0; r < rounds; ++r) {
+                // a few clusters around our base
+                vector<Point> points;
+                vector<int> weights;
+                vector<int> hits;
+                Point centers[3];
+                for (auto & c : centers) c = Point(rng.between(0, kMidCircle), rng.between(0, kMidCircle));
+                for (int i = 0; i < n; ++i) {
+                    const auto & c = centers[rng.between(0, 2)];
+                    points.push_back(Point(c.x + rng.between(-1500, 1500), c.y + rng.between(-1500, 1500)));
+                    weights.push_back(rng.between(1, 100));
+                    hits.push_back(rng.between(1, 15));
+                }
+
+                auto start = std::chrono::steady_clock::now();
+                cover.solve(points, weights, hits, circles, kHeroPhysicAttackRange, kOurCorner);
+                std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+                latencies.push_back(elapsed.count());
+            }
+            sort(latencies.begin(), latencies.end());
+            worst = std::max(worst, percentile(latencies, 0.99));
+            cout << "circles=" << circles << "; monsters=" << n << "; p50=" << percentile(latencies, 0.5) << "us";
+            cout << "; p99=" << percentile(latencies, 0.99) << "us";
+            cout << "; max=" << latencies.back() << "us" << endl;
+        }
+    }
+    bool ok = worst <= budget;
+    cout << "budget=" << budget << "us; " << (ok ? "ok" : "exceeded") << endl;
+    return ok ? 0 : 1;
+}
+
+// A cheap scripted player, the same on both referees: the heros go for the monsters that
+// threaten our base and blow away the closest ones; the second one shields the monsters
+// on their way to the other base, the third one controls the opponents and sends the
+// monsters over there.
+void scripted_orders(const Base & ours, const vector<Entity> & units, Action orders[kHerosPerPlayer]) {
+    Point theirs(kWidth - ours.pos.x, kHeight - ours.pos.y);
+    int mp = ours.mp;
+    int idx = 0;
+    for (const auto & h : units) {
+        if (h.type != 1 || idx >= kHerosPerPlayer) continue;
+
+        auto & a = orders[idx];
+        a = Action();
+        a.subject = idx;
+        const Entity * best = nullptr;
+        const Entity * opponent = nullptr;
+        for (const auto & e : units) {
+            if (e.type == 2 && e.shield == 0 && within(e.pos, h.pos, kSpellRange)) opponent = &e;
+            if (e.type != 0) continue;
+            if (best == nullptr || (e.threat == 1) > (best->threat == 1)
+                || ((e.threat == 1) == (best->threat == 1) && distance2(e.pos, h.pos) < distance2(best->pos, h.pos))) {
+                best = &e;
+            }
+        }
+
+        bool reachable = best && best->shield == 0 && within(best->pos, h.pos, kSpellRange);
+        if (best && best->threat == 1 && best->shield == 0 && mp >= 2 * kMagicManaCost
+            && within(best->pos, h.pos, kRadiusOfWind) && within(best->pos, ours.pos, 4000)) {
+            a.verb = WIND;
+            a.dest = theirs;
+        } else if (idx == 1 && reachable && best->threat == 2 && mp >= 10 * kMagicManaCost) {
+            a.verb = PROTECT;
+            a.object = best->id;
+        } else if (idx == 2 && opponent && mp >= 8 * kMagicManaCost) {
+            a.verb = CONTROL;
+            a.object = opponent->id;
+            a.dest = Point(kWidth / 2, kHeight / 2);
+        } else if (idx == 2 && reachable && best->threat != 1 && !best->mad && mp >= 5 * kMagicManaCost) {
+            a.verb = CONTROL;
+            a.object = best->id;
+            a.dest = theirs;
+        } else if (best) {
+            a.verb = MOVE;
+            a.dest = best->pos + best->v;
+        } else {
+            // a post on the way to the other base
+            a.verb = MOVE;
+            a.dest = Point((ours.pos.x + theirs.x) / 2 + (idx - 1) * 2000, kHeight / 2);
+        }
+        if (a.verb != MOVE) mp -= kMagicManaCost;
+        ++idx;
+    }
+}
+
+// how a game ended
+struct Outcome {
+    int winner;
+    int turns;
+    int hp[2];
+    int mp[2];
+    int wild[2];
+
+    bool operator==(const Outcome & o) const {
+        return winner == o.winner && turns == o.turns && hp[0] == o.hp[0] && hp[1] == o.hp[1]
+            && mp[0] == o.mp[0] && mp[1] == o.mp[1] && wild[0] == o.wild[0] && wild[1] == o.wild[1];
+    }
+};
+
+int bench_batch(int games) {
+    using Clock = std::chrono::steady_clock;
+    const uint64_t seed = 1;
+    vector<Entity> units;
+    units.reserve(kMaxEntities);
+    Action orders[kHerosPerPlayer];
+
+    // game by game
+    vector<Outcome> expected;
+    double steps = 0;
+    auto start = Clock::now();
+    for (int g = 0; g < games; ++g) {
+        Simulator sim(seed + g);
+        while (!sim.over()) {
+            for (int p = 0; p < 2; ++p) {
+                units = sim.observe(p);
+                scripted_orders(sim.base(p), units, orders);
+                for (int i = 0; i < kHerosPerPlayer; ++i) sim.order(p, i, orders[i]);
+            }
+            auto t0 = Clock::now();
+            sim.step();
+            steps += std::chrono::duration<double>(Clock::now() - t0).count();
+        }
+        expected.push_back({ sim.winner(), sim.turns(), { sim.base(0).hp, sim.base(1).hp },
+                             { sim.base(0).mp, sim.base(1).mp }, { sim.wildMana(0), sim.wildMana(1) } });
+    }
+    double total = std::chrono::duration<double>(Clock::now() - start).count();
+    cout << "scalar: games=" << games << "; step games/s=" << (long long)(games / steps);
+    cout << "; total games/s=" << (long long)(games / total) << endl;
+
+    int mismatches = 0;
+    for (int size : { 64, 256 }) {
+        steps = 0;
+        int played = 0;
+        start = Clock::now();
+        for (int first = 0; first < games; first += size) {
+            int n = std::min(size, games - first);
+            BatchSimulator batch(seed + first, n);
+            while (!batch.over()) {
+                for (int g = 0; g < n; ++g) {
+                    if (batch.over(g)) continue;
+                    for (int p = 0; p < 2; ++p) {
+                        batch.observe(g, p, units);
+                        scripted_orders(batch.base(g, p), units, orders);
+                        for (int i = 0; i < kHerosPerPlayer; ++i) batch.order(g, p, i, orders[i]);
+                    }
+                }
+                auto t0 = Clock::now();
+                batch.step();
+                steps += std::chrono::duration<double>(Clock::now() - t0).count();
+            }
+            for (int g = 0; g < n; ++g) {
+                Outcome o = { batch.winner(g), batch.turns(g), { batch.base(g, 0).hp, batch.base(g, 1).hp },
+                              { batch.base(g, 0).mp, batch.base(g, 1).mp }, { batch.wildMana(g, 0), batch.wildMana(g, 1) } };
+                if (!(o == expected[first + g])) ++mismatches;
+            }
+            played += n;
+        }
+        total = std::chrono::duration<double>(Clock::now() - start).count();
+        cout << "batch=" << size << ": games=" << played << "; step games/s=" << (long long)(played / steps);
+        cout << "; total games/s=" << (long long)(played / total) << endl;
+    }
+    cout << "mismatches=" << mismatches << "; " << (mismatches == 0 ? "ok" : "failed") << endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int bench_deadline(int games, double slack) {
+    using Clock = std::chrono::steady_clock;
+    double worst = 0; // p99 past the budget
+    for (int budget : { 5, 20, 100, 1000, kTurnTime }) {
+        Brain brains[2];
+        for (auto & brain : brains) {
+            brain.set_log(nullptr);
+            brain.set_time_budget(budget);
+        }
+        vector<double> latencies;
+        int fallbacks = 0;
+        int replanned = 0;
+        TurnInput input;
+        for (int g = 0; g < games; ++g) {
+            Simulator sim(1 + g);
+            for (int p = 0; p < 2; ++p) brains[p].init(sim.base(p).pos);
+            while (!sim.over()) {
+                for (int p = 0; p < 2; ++p) {
+                    input.ours = sim.base(p);
+                    input.theirs = sim.base(1 - p);
+                    input.units = sim.observe(p);
+                    auto start = Clock::now();
+                    const auto & output = brains[p].step(input);
+                    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+                    latencies.push_back(elapsed.count());
+                    if (brains[p].passes() == 0) ++fallbacks;
+                    if (brains[p].passes() > 1) ++replanned;
+                    sim.order(p, output);
+                }
+                sim.step();
+            }
+        }
+        sort(latencies.begin(), latencies.end());
+        worst = std::max(worst, percentile(latencies, 0.99) - budget);
+        cout << "budget=" << budget << "us; turns=" << latencies.size();
+        cout << "; fallback=" << fallbacks << "; replanned=" << replanned;
+        cout << "; p50=" << percentile(latencies, 0.5) << "us";
+        cout << "; p99=" << percentile(latencies, 0.99) << "us";
+        cout << "; max=" << latencies.back() << "us" << endl;
+    }
+    bool ok = worst <= slack;
+    cout << "slack=" << slack << "us; " << (ok ? "ok" : "exceeded") << endl;
+
+    // turns beyond the caps, without a deadline: every pass is made
+    Brain brain;
+    brain.set_log(nullptr);
+    brain.init(kOurCorner);
+    Rng rng(1);
+    TurnInput input;
+    input.ours.hp = input.theirs.hp = 3;
+    input.ours.mp = input.theirs.mp = 200;
+    vector<double> latencies;
+    for (int r = 0; r < games * 10; ++r) {
+        input.units.clear();
+        for (int id = 0; id < 2 * kHerosPerPlayer; ++id) {
+            Entity e = {};
+            e.id = id;
+            e.type = id < kHerosPerPlayer ? 1 : 2;
+            e.pos = Point(rng.between(0, kMidCircle), rng.between(0, kMidCircle));
+            input.units.push_back(e);
+        }
+        for (const auto & m : random_crowd(rng, 4 * kMaxMonsters)) input.units.push_back(m);
+        auto start = Clock::now();
+        brain.step(input);
+        std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+        latencies.push_back(elapsed.count());
+    }
+    sort(latencies.begin(), latencies.end());
+    bool bounded = latencies.back() <= kTurnTime;
+    cout << "caps: monsters=" << 4 * kMaxMonsters << " (" << kMaxMonsters << " played); turns=" << latencies.size();
+    cout << "; p50=" << percentile(latencies, 0.5) << "us; max=" << latencies.back() << "us; ";
+    cout << (bounded ? "ok" : "exceeded") << endl;
+    return ok && bounded ? 0 : 1;
+}
+
+int bench_store(int turns) {
+    const int bound = 4 * kMaxEntities; // reserved by EntityStore
+    int worst = 0;
+
+    // heros refreshed every turn, short-lived monsters
+    EntityStore store;
+    int nextId = EntityStore::kHeroIds;
+    for (int t = 0; t < turns; ++t) {
+        store.begin_turn();
+        for (int id = 0; id < kHerosPerPlayer; ++id) {
+            Entity e = {};
+            e.id = id;
+            e.type = 1;
+            store.put(e);
+        }
+        for (int k = 0; k < 2; ++k) {
+            Entity e = {};
+            e.id = nextId++;
+            store.put(e);
+        }
+        store.evict(kForgetAfter);
+        worst = std::max(worst, store.span());
+    }
+    cout << "synthetic: turns=" << turns << "; ids=" << nextId << "; known=" << store.size();
+    cout << "; span=" << store.span() << "; max span=" << worst << endl;
+
+    // what the players see in self-play
+    int games = 20;
+    int gameWorst = 0;
+    for (int g = 0; g < games; ++g) {
+        Simulator sim(1 + g);
+        Brain brains[2];
+        EntityStore stores[2];
+        for (int p = 0; p < 2; ++p) {
+            brains[p].set_log(nullptr);
+            brains[p].init(sim.base(p).pos);
+        }
+        TurnInput input;
+        while (!sim.over()) {
+            for (int p = 0; p < 2; ++p) {
+                input.ours = sim.base(p);
+                input.theirs = sim.base(1 - p);
+                input.units = sim.observe(p);
+                stores[p].begin_turn();
+                for (const auto & e : input.units) stores[p].put(e);
+                stores[p].evict(kForgetAfter);
+                gameWorst = std::max(gameWorst, stores[p].span());
+                sim.order(p, brains[p].step(input));
+            }
+            sim.step();
+        }
+    }
+    cout << "self-play: games=" << games << "; max span=" << gameWorst << endl;
+    worst = std::max(worst, gameWorst);
+
+    bool ok = worst <= bound;
+    cout << "bound=" << bound << "; " << (ok ? "ok" : "exceeded") << endl;
+    return ok ? 0 : 1;
+}
+
+const char * kernel_path() {
+#if defined(BRAIN_AVX2)
+    return "avx2";
+#elif defined(BRAIN_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// monsters anywhere, a few of them off the map
+vector<Monster> random_monsters(Rng & rng, int n) {
+    vector<Monster> monsters;
+    for (int i = 0; i < n; ++i) {
+        Entity e = {};
+        e.id = kFirstMonsterId + i;
+        e.pos = Point(rng.between(-2000, kWidth + 2000), rng.between(-2000, kHeight + 2000));
+        e.v = Point(rng.between(-kMonsterSpeed, kMonsterSpeed), rng.between(-kMonsterSpeed, kMonsterSpeed));
+        e.hp = rng.between(1, 30);
+        e.shield = rng.between(0, 3) == 0 ? rng.between(1, 12) : 0;
+        monsters.push_back(e);
+    }
+    return monsters;
+}
+
+int bench_table(int turns) {
+    Rng rng(1);
+    MonsterTable table;
+    vector<int> found;
+    vector<int> d2;
+    vector<int> xs;
+    vector<int> ys;
+    const int radii[] = { kHeroPhysicAttackRange, kRadiusOfWind, kHeroViewRange };
+    int mismatches = 0;
+    long long checks = 0;
+    for (int t = 0; t < turns && mismatches == 0; ++t) {
+        // a crowded turn now and then (beyond kMaxEntities)
+        int crowd = t % 16 == 0 ? rng.between(kMaxEntities, kMaxEntities + 64) : rng.between(0, 64);
+        auto monsters = random_monsters(rng, crowd);
+        table.build(monsters);
+        d2.resize(table.padded());
+        xs.resize(table.padded());
+        ys.resize(table.padded());
+        int n = monsters.size();
+        Point p(rng.between(-2000, kWidth + 2000), rng.between(-2000, kHeight + 2000));
+        // close to a monster half of the times
+        if (n > 0 && rng.between(0, 1)) p = monsters[rng.between(0, n - 1)].pos + Point(rng.between(-900, 900), 0);
+
+        for (int r : { 0, kHeroPhysicAttackRange, kRadiusOfWind, kHeroViewRange, kBaseViewRange, 40000 }) {
+            table.within(p, r, found);
+            vector<int> expected;
+            int unshielded = 0;
+            for (int i = 0; i < n; ++i) {
+                if (!within(monsters[i].pos, p, r)) continue;
+                expected.push_back(i);
+                if (monsters[i].shield == 0) ++unshielded;
+            }
+            if (found != expected) ++mismatches;
+            if (table.count_within(p, r) != (int) expected.size()) ++mismatches;
+            if (table.count_within(p, r, true) != unshielded) ++mismatches;
+            checks += 3;
+        }
+
+        MonsterMask masks[3];
+        table.masks(p, radii, 3, masks);
+        auto unshielded = table.unshielded();
+        table.distances2(p, d2.data());
+        int k = rng.between(0, 2 * MonsterForecast::kTurns);
+        table.step(k, xs.data(), ys.data());
+        for (int i = 0; i < n; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                if (masks[k].test(i) != within(monsters[i].pos, p, radii[k])) ++mismatches;
+            }
+            if (unshielded.test(i) != (monsters[i].shield == 0)) ++mismatches;
+            if (d2[i] != distance2(monsters[i].pos, p)) ++mismatches;
+            if (!(Point(xs[i], ys[i]) == monsters[i].pos + Point(k * monsters[i].v.x, k * monsters[i].v.y))) ++mismatches;
+            checks += 6;
+        }
+    }
+    cout << "path=" << kernel_path() << "; turns=" << turns << "; checks=" << checks;
+    cout << "; mismatches=" << mismatches << "; " << (mismatches == 0 ? "ok" : "failed") << endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+// The uniform grid which indexed the monsters before MonsterTable: counting sort of the
+// monsters by cell, then a walk over the cells overlapping the range.
+class SpatialGrid {
+public:
+    static constexpr int kCellSize = 1000;
+    static constexpr int kCols = kWidth / kCellSize + 1;
+    static constexpr int kRows = kHeight / kCellSize + 1;
+
+    SpatialGrid() : m_start(kCols * kRows + 1, 0), m_cursor(kCols * kRows, 0) {}
+
+    void build(const vector<Monster> & monsters) {
+        int n = monsters.size();
+        m_pos.resize(n);
+        m_items.resize(n);
+        std::fill(m_start.begin(), m_start.end(), 0);
+        for (int i = 0; i < n; ++i) {
+            m_pos[i] = monsters[i].pos;
+            ++m_start[cell_of(m_pos[i]) + 1];
+        }
+        for (int c = 0; c < kCols * kRows; ++c) m_start[c + 1] += m_start[c];
+        std::copy(m_start.begin(), m_start.end() - 1, m_cursor.begin());
+        for (int i = 0; i < n; ++i) m_items[m_cursor[cell_of(m_pos[i])]++] = i;
+    }
+
+    // the indices of the monsters within the range, in ascending order
+    void query(const Point & pos, int range, vector<int> & out) const {
+        out.clear();
+        int x0 = clamp_col(floor_div(pos.x - range));
+        int x1 = clamp_col(floor_div(pos.x + range));
+        int y0 = clamp_row(floor_div(pos.y - range));
+        int y1 = clamp_row(floor_div(pos.y + range));
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                int c = y * kCols + x;
+                for (int k = m_start[c]; k < m_start[c + 1]; ++k) {
+                    int i = m_items[k];
+                    if (within(m_pos[i], pos, range)) out.push_back(i);
+                }
+            }
+        }
+        sort(out.begin(), out.end());
+    }
+
+private:
+    static int floor_div(int v) {
+        return v >= 0 ? v / kCellSize : -((-v + kCellSize - 1) / kCellSize);
+    }
+
+    static int clamp_col(int x) { return std::min(std::max(x, 0), kCols - 1); }
+    static int clamp_row(int y) { return std::min(std::max(y, 0), kRows - 1); }
+
+    static int cell_of(const Point & p) {
+        return clamp_row(floor_div(p.y)) * kCols + clamp_col(floor_div(p.x));
+    }
+
+    vector<Point> m_pos;
+    vector<int> m_items; // monster indices grouped by cell
+    vector<int> m_start; // m_items[m_start[c], m_start[c + 1]) are in the cell c
+    vector<int> m_cursor;
+};
+
+int bench_index(int rounds) {
+    using Clock = std::chrono::steady_clock;
+    Rng rng(1);
+    MonsterTable table;
+    SpatialGrid grid;
+    vector<int> a;
+    vector<int> b;
+    a.reserve(kMaxEntities);
+    b.reserve(kMaxEntities);
+    const int kQueries = 16; // per turn, as many as discover() and the reaches of a turn
+    bool ok = true;
+    for (int n : { 64, 256 }) {
+        double tableTime = 0;
+        double gridTime = 0;
+        long long found = 0;
+        int mismatches = 0;
+        for (int r = 0; r < rounds; ++r) {
+            vector<Monster> monsters;
+            for (int i = 0; i < n; ++i) {
+                Entity e = {};
+                e.id = kFirstMonsterId + i;
+                e.pos = Point(rng.between(0, kWidth), rng.between(0, kHeight));
+                monsters.push_back(e);
+            }
+            Point points[kQueries];
+            int radii[kQueries];
+            for (int q = 0; q < kQueries; ++q) {
+                points[q] = Point(rng.between(0, kWidth), rng.between(0, kHeight));
+                radii[q] = q % 2 ? kHeroViewRange : kRadiusOfWind;
+            }
+
+            // the building of the index counts: both are rebuilt every turn
+            auto t0 = Clock::now();
+            table.build(monsters);
+            for (int q = 0; q < kQueries; ++q) {
+                table.within(points[q], radii[q], a);
+                found += a.size();
+            }
+            auto t1 = Clock::now();
+            grid.build(monsters);
+            for (int q = 0; q < kQueries; ++q) {
+                grid.query(points[q], radii[q], b);
+                found -= b.size();
+            }
+            auto t2 = Clock::now();
+            tableTime += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            gridTime += std::chrono::duration<double, std::micro>(t2 - t1).count();
+
+            // the same answers
+            for (int q = 0; q < kQueries; ++q) {
+                table.within(points[q], radii[q], a);
+                grid.query(points[q], radii[q], b);
+                if (a != b) ++mismatches;
+            }
+        }
+        cout << "path=" << kernel_path() << "; monsters=" << n << "; queries/turn=" << kQueries;
+        cout << "; table=" << tableTime / rounds << "us/turn; grid=" << gridTime / rounds << "us/turn";
+        cout << "; mismatches=" << mismatches << endl;
+        ok = ok && mismatches == 0 && found == 0 && tableTime <= gridTime;
+    }
+    cout << (ok ? "ok" : "failed") << endl;
+    return ok ? 0 : 1;
+}
+
+// The forecast before MonsterTable::step(): every monster moved one by one, turn after turn.
+class ScalarForecast {
+public:
+    void build(const vector<Monster> & monsters, const Base & ours, const Base & theirs) {
+        m_size = monsters.size();
+        m_bases[0] = ours.pos;
+        m_bases[1] = theirs.pos;
+        m_x.resize((MonsterForecast::kTurns + 1) * m_size);
+        m_y.resize((MonsterForecast::kTurns + 1) * m_size);
+        for (auto * v : { &m_end, &m_target, &m_inside[0], &m_inside[1], &m_hit[0], &m_hit[1] }) {
+            v->assign(m_size, MonsterForecast::kNever);
+        }
+        for (int i = 0; i < m_size; ++i) {
+            const auto & m = monsters[i];
+            m_x[i] = m.pos.x;
+            m_y[i] = m.pos.y;
+            m_end[i] = m.pos.valid() ? MonsterForecast::kTurns + 1 : 0;
+            if (m.target != 0 && (m.threat == 1 || m.threat == 2)) m_target[i] = m.threat - 1;
+            for (int b = 0; b < 2; ++b) {
+                if (within(m.pos, m_bases[b], kRadiusOfBase)) m_inside[b][i] = 0;
+            }
+        }
+        for (int t = 1; t <= MonsterForecast::kTurns; ++t) {
+            for (int i = 0; i < m_size; ++i) {
+                Point p(m_x[(t - 1) * m_size + i], m_y[(t - 1) * m_size + i]);
+                if (t < m_end[i]) p = advance(p, monsters[i].v, i, t);
+                m_x[t * m_size + i] = p.x;
+                m_y[t * m_size + i] = p.y;
+            }
+        }
+    }
+
+    Point at(int row, int t) const { return Point(m_x[t * m_size + row], m_y[t * m_size + row]); }
+    bool alive(int row, int t) const { return t < m_end[row]; }
+    int inside(int row, int base) const { return m_inside[base][row]; }
+    int hit(int row, int base) const { return m_hit[base][row]; }
+
+private:
+    Point advance(Point p, const Point & v, int i, int t) {
+        int b = m_target[i];
+        if (b >= 0) {
+            if (distance(p, m_bases[b]) <= kMonsterSpeed) {
+                p = m_bases[b];
+            } else {
+                p += scale_toward(p, m_bases[b], kMonsterSpeed);
+            }
+            if (within(p, m_bases[b], kBaseAttackRange)) m_hit[b][i] = m_end[i] = t;
+            return p;
+        }
+        p += v;
+        if (!p.valid()) {
+            m_end[i] = t;
+            return p;
+        }
+        for (b = 0; b < 2; ++b) {
+            if (!within(p, m_bases[b], kRadiusOfBase)) continue;
+            m_target[i] = b;
+            m_inside[b][i] = t;
+            break;
+        }
+        return p;
+    }
+
+    int m_size = 0;
+    Point m_bases[2];
+    vector<int> m_x;
+    vector<int> m_y;
+    vector<int> m_end;
+    vector<int> m_target;
+    vector<int> m_inside[2];
+    vector<int> m_hit[2];
+};
+
+int bench_forecast(int rounds) {
+    using Clock = std::chrono::steady_clock;
+    Rng rng(1);
+    Base ours;
+    Base theirs;
+    ours.pos = kOurCorner;
+    theirs.pos = kTheirCorner;
+    MonsterTable table;
+    MonsterForecast forecast;
+    ScalarForecast reference;
+    int mismatches = 0;
+    for (int n : { 64, 256 }) {
+        double kernelTime = 0;
+        double scalarTime = 0;
+        for (int r = 0; r < rounds; ++r) {
+            vector<Monster> monsters;
+            for (int i = 0; i < n; ++i) {
+                Entity e = {};
+                e.id = kFirstMonsterId + i;
+                e.pos = Point(rng.between(-500, kWidth + 500), rng.between(-500, kHeight + 500));
+                e.v = compute_cartesian_point(ours, kMonsterSpeed, rng.between(0, 359)) - ours.pos;
+                e.target = rng.between(0, 3) == 0;
+                e.threat = e.target ? rng.between(1, 2) : 0;
+                monsters.push_back(e);
+            }
+            // the table is built by the parse anyway
+            table.build(monsters);
+            auto t0 = Clock::now();
+            reference.build(monsters, ours, theirs);
+            auto t1 = Clock::now();
+            forecast.build(monsters, table, ours, theirs);
+            auto t2 = Clock::now();
+            scalarTime += std::chrono::duration<double, std::micro>(t1 - t0).count();
+            kernelTime += std::chrono::duration<double, std::micro>(t2 - t1).count();
+
+            for (int i = 0; i < n; ++i) {
+                for (int t = 0; t <= MonsterForecast::kTurns; ++t) {
+                    if (!(forecast.at(i, t) == reference.at(i, t))) ++mismatches;
+                    if (forecast.alive(i, t) != reference.alive(i, t)) ++mismatches;
+                }
+                for (int b = 0; b < 2; ++b) {
+                    if (forecast.inside(i, b) != reference.inside(i, b)) ++mismatches;
+                    if (forecast.hit(i, b) != reference.hit(i, b)) ++mismatches;
+                }
+            }
+        }
+        cout << "path=" << kernel_path() << "; monsters=" << n << "; step=" << kernelTime / rounds;
+        cout << "us/build; scalar=" << scalarTime / rounds << "us/build" << endl;
+    }
+    cout << "mismatches=" << mismatches << "; " << (mismatches == 0 ? "ok" : "failed") << endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int bench_timeline(int games) {
+    // (the turn from now, id) of the next hit, (-1, -1) for none
+    auto head = [](const ThreatTimeline & timeline) {
+        if (timeline.empty()) return pair<int, int>(-1, -1);
+        const auto & e = timeline.next();
+        return pair<int, int>(e.turn - timeline.turn(), e.id);
+    };
+
+    long long turns = 0;
+    int mismatches = 0;
+    TurnInput input;
+    vector<Monster> monsters;
+    for (int g = 0; g < games; ++g) {
+        Simulator sim(1 + g);
+        Brain brains[2];
+        EntityStore stores[2];
+        ThreatTimeline timelines[2];
+        MonsterTable table;
+        MonsterForecast forecast;
+        for (int p = 0; p < 2; ++p) {
+            brains[p].set_log(nullptr);
+            brains[p].init(sim.base(p).pos);
+        }
+        for (int t = 0; !sim.over(); ++t) {
+            for (int p = 0; p < 2; ++p) {
+                input.ours = sim.base(p);
+                input.theirs = sim.base(1 - p);
+                input.units = sim.observe(p);
+
+                auto & store = stores[p];
+                store.begin_turn();
+                monsters.clear();
+                for (const auto & e : input.units) {
+                    store.put(e);
+                    if (e.type == 0) monsters.push_back(e);
+                }
+                store.evict(kForgetAfter);
+                table.build(monsters);
+                forecast.build(monsters, table, input.ours, input.theirs);
+
+                // a turn skipped now and then, as past the deadline
+                if (t % 17 == 16) {
+                    timelines[p].skip_turn();
+                } else {
+                    ThreatTimeline fresh;
+                    for (auto * timeline : { &timelines[p], &fresh }) {
+                        timeline->begin_turn();
+                        for (size_t i = 0; i < monsters.size(); ++i) {
+                            bool near = within(monsters[i].pos, input.ours.pos, kMidCircle);
+                            timeline->observe_monster(store.find(monsters[i].id).slot, monsters[i], forecast, i, near);
+                        }
+                        timeline->end_turn();
+                    }
+
+                    // the next hit among the monsters near the base, by a scan of the forecast
+                    pair<int, int> expected(-1, -1);
+                    for (size_t i = 0; i < monsters.size(); ++i) {
+                        int hit = forecast.hit(i, 0);
+                        if (hit == MonsterForecast::kNever || !within(monsters[i].pos, input.ours.pos, kMidCircle)) continue;
+                        pair<int, int> x(hit, monsters[i].id);
+                        if (expected.first < 0 || x < expected) expected = x;
+                    }
+                    if (head(timelines[p]) != expected) ++mismatches;
+                    if (head(fresh) != expected) ++mismatches;
+                }
+
+                sim.order(p, brains[p].step(input));
+                ++turns;
+            }
+            sim.step();
+        }
+    }
+    cout << "games=" << games << "; turns=" << turns << "; mismatches=" << mismatches;
+    cout << "; " << (mismatches == 0 ? "ok" : "failed") << endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int bench_lanes() {
+    const int thresholds[] = { k30Degree, k30Degree + 1, k45Degree + 1, k60Degree };
+    long long checks = 0;
+    long long mismatches = 0;
+    for (int dx = -kWidth; dx <= kWidth; ++dx) {
+        for (int dy = -kHeight; dy <= kHeight; ++dy) {
+            int expected = dx == 0 ? (dy >= 0 ? 90 : 0) : convert_radian_to_degree(std::atan((double) dy / dx));
+            Direction dir(Point(0, 0), Point(dx, dy));
+            if (dir.degree() != expected) ++mismatches;
+            for (int d : thresholds) {
+                if (dir.at_least(d) != (expected >= d)) ++mismatches;
+            }
+            checks += 5;
+        }
+    }
+    cout << "checks=" << checks << "; mismatches=" << mismatches;
+    cout << "; " << (mismatches == 0 ? "ok" : "failed") << endl;
+    return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char ** argv)
+{
+    string what = argc > 1 ? argv[1] : "";
+    if (what == "assign") {
+        int rounds = argc > 2 ? std::atoi(argv[2]) : 10000;
+        double budget = argc > 3 ? std::atof(argv[3]) : 50;
+        return bench_assign(rounds, budget);
+    }
+    if (what == "cover") {
+        int rounds = argc > 2 ? std::atoi(argv[2]) : 2000;
+        double budget = argc > 3 ? std::atof(argv[3]) : 250;
+        return bench_cover(rounds, budget);
+    }
+    if (what == "batch") {
+        int games = argc > 2 ? std::atoi(argv[2]) : 1024;
+        return bench_batch(games);
+    }
+    if (what == "deadline") {
+        int games = argc > 2 ? std::atoi(argv[2]) : 20;
+        double slack = argc > 3 ? std::atof(argv[3]) : 100;
+        return bench_deadline(games, slack);
+    }
+    if (what == "table") {
+        int turns = argc > 2 ? std::atoi(argv[2]) : 20000;
+        return bench_table(turns);
+    }
+    if (what == "index") {
+        int rounds = argc > 2 ? std::atoi(argv[2]) : 20000;
+        return bench_index(rounds);
+    }
+    if (what == "timeline") {
+        int games = argc > 2 ? std::atoi(argv[2]) : 40;
+        return bench_timeline(games);
+    }
+    if (what == "forecast") {
+        int rounds = argc > 2 ? std::atoi(argv[2]) : 10000;
+        return bench_forecast(rounds);
+    }
+    if (what == "lanes") {
+        return bench_lanes();
+    }
+    if (what == "store") {
+        int turns = argc > 2 ? std::atoi(argv[2]) : 100000;
+        return bench_store(turns);
+    }
+    cerr << "usage: " << argv[0] << " assign|cover [rounds] [budget_us]" << endl;
+    cerr << "       " << argv[0] << " batch [games]" << endl;
+    cerr << "       " << argv[0] << " deadline [games] [slack_us]" << endl;
+    cerr << "       " << argv[0] << " store [turns]" << endl;
+    cerr << "       " << argv[0] << " table [turns]" << endl;
+    cerr << "       " << argv[0] << " index [rounds]" << endl;
+    cerr << "       " << argv[0] << " timeline [games]" << endl;
+    cerr << "       " << argv[0] << " lanes" << endl;
+    cerr << "       " << argv[0] << " forecast [rounds]" << endl;
+    return 1;
+}
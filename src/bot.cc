@@ -0,0 +1,39 @@
+// The bot built on the library (make bot): the same protocol as main() in game.cc,
+// the standard I/O being done here and nowhere else.
+//
+// usage: bot.out < referee
+
+#include "brain.h"
+
+#include <iostream>
+
+int main()
+{
+    std::ios::sync_with_stdio(false);
+    int baseX, baseY, heros;
+    if (!(std::cin >> baseX >> baseY >> heros)) return 1;
+
+    brain::Session session;
+    session.set_log(&std::cerr);
+    session.set_time_budget(brain::kTurnTime);
+    session.init(baseX, baseY);
+
+    brain::TurnInput input;
+    while (std::cin >> input.hp[0] >> input.mp[0] >> input.hp[1] >> input.mp[1]) {
+        int count;
+        std::cin >> count;
+        input.units.resize(count);
+        for (auto & u : input.units) {
+            std::cin >> u.id >> u.type >> u.x >> u.y >> u.shield >> u.mad >> u.hp;
+            std::cin >> u.vx >> u.vy >> u.target >> u.threat;
+        }
+        if (!std::cin) break;
+
+        const auto & output = session.step(input);
+        for (int i = 0; i < output.count; ++i) {
+            std::cout << output.orders[i].line << '\n';
+        }
+        std::cout.flush();
+    }
+    return 0;
+}
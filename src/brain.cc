@@ -0,0 +1,75 @@
+// The library of the bot (make lib): game.cc behind the API of brain.h.
+
+#define BRAIN_NO_MAIN
+#include "game.cc"
+#include "brain.h"
+
+// the verbs are passed through as they are
+static_assert(brain::Wait == (int) WAIT && brain::Move == (int) MOVE && brain::Wind == (int) WIND
+              && brain::Shield == (int) PROTECT && brain::Control == (int) CONTROL, "Verb and Command differ");
+
+struct brain::Session::Impl {
+    Brain bot;
+    ::TurnInput input; // reused from one turn to the next
+    brain::TurnOutput output;
+
+    Impl() : output() {
+        bot.set_log(nullptr);
+        input.units.reserve(kMaxEntities);
+    }
+};
+
+namespace brain {
+
+Session::Session() : m_impl(new Impl()) {}
+
+Session::~Session() = default;
+Session::Session(Session && other) noexcept = default;
+Session & Session::operator=(Session && other) noexcept = default;
+
+void Session::init(int baseX, int baseY) {
+    m_impl->bot.init(Point(baseX, baseY));
+}
+
+const TurnOutput & Session::step(const TurnInput & in) {
+    auto & input = m_impl->input;
+    input.ours.update(in.hp[0], in.mp[0]);
+    input.theirs.update(in.hp[1], in.mp[1]);
+    input.units.clear();
+    for (const auto & u : in.units) {
+        Entity e;
+        e.id = u.id;
+        e.type = u.type;
+        e.pos = Point(u.x, u.y);
+        e.shield = u.shield;
+        e.mad = u.mad != 0;
+        e.hp = u.hp;
+        e.v = Point(u.vx, u.vy);
+        e.target = u.target;
+        e.threat = u.threat;
+        input.units.push_back(e);
+    }
+
+    const auto & commands = m_impl->bot.step(input);
+    auto & output = m_impl->output;
+    output.count = commands.count;
+    for (int i = 0; i < commands.count; ++i) {
+        const auto & o = commands.orders[i];
+        output.orders[i].verb = (Verb) o.verb;
+        output.orders[i].object = o.object;
+        output.orders[i].x = o.dest.x;
+        output.orders[i].y = o.dest.y;
+        output.orders[i].line = commands.lines[i].c_str();
+    }
+    return output;
+}
+
+void Session::set_log(std::ostream * os) {
+    m_impl->bot.set_log(os);
+}
+
+void Session::set_time_budget(int micros) {
+    m_impl->bot.set_time_budget(micros);
+}
+
+} // namespace brain
@@ -0,0 +1,90 @@
+#ifndef BRAIN_H
+#define BRAIN_H
+
+// The bot as a library (make lib), for the programs that link it rather than
+// include game.cc: a session per game, init() once, then step() once per turn.
+//
+// No standard I/O is involved: what a player sees comes in, the commands of its
+// heros go out, and the debug output goes to the stream given to set_log() (none
+// by default). All the points are in the real map.
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace brain {
+
+const int kHeros = 3; // per player
+const int kTurnTime = 40000; // us for the decisions of a turn (the referee allows 50 ms)
+
+// an entity as given by the referee
+struct Unit {
+    int id;
+    int type; // 0=monster, 1=our hero, 2=their hero
+    int x;
+    int y;
+    int shield;
+    int mad;
+    int hp;
+    int vx;
+    int vy;
+    int target;
+    int threat; // 0=neither base, 1=our base, 2=their base
+};
+
+struct TurnInput {
+    int hp[2]; // ours, theirs
+    int mp[2];
+    std::vector<Unit> units;
+};
+
+enum Verb {
+    Wait,
+    Move,
+    Wind,
+    Shield,
+    Control,
+};
+
+struct Order {
+    Verb verb;
+    int object; // the id of the target of SHIELD and CONTROL
+    int x; // where to MOVE, WIND or CONTROL
+    int y;
+    const char * line; // the text expected by the referee
+};
+
+// one order per hero, in the order of their ids (valid until the next step())
+struct TurnOutput {
+    int count;
+    Order orders[kHeros];
+};
+
+class Session {
+public:
+    Session();
+    ~Session();
+    Session(Session && other) noexcept;
+    Session & operator=(Session && other) noexcept;
+
+    // a new game, our base being at this corner
+    void init(int baseX, int baseY);
+
+    // the input having just been read
+    const TurnOutput & step(const TurnInput & in);
+
+    // nullptr for nowhere
+    void set_log(std::ostream * os);
+
+    // the time of the decisions of a turn, from the call to step(), in us (none by default:
+    // the decisions then only depend on the input)
+    void set_time_budget(int micros);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+} // namespace brain
+
+#endif // BRAIN_H
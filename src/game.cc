@@ -1,13 +1,35 @@
 #include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <queue>
-#include <sstream>
+#include <limits>
+#include <memory>
+#include <new>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include <errno.h>
+#include <unistd.h>
+
+#if !defined(BRAIN_NO_SIMD) && defined(__AVX2__)
+#define BRAIN_AVX2
+#include <immintrin.h>
+#elif !defined(BRAIN_NO_SIMD) && defined(__SSE2__)
+#define BRAIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef BRAIN_PROFILE
+#include <fstream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
+
 using namespace std;
 
 /*****************************************************************************
@@ -27,8 +49,10 @@ const int kInnerCircle = 2800;
 const int kMidCircle = 6000; // at the outskirt of the base
 const int kOutterCircle = 7000;
 const int kMonsterSpeed = 400;
+const int kBaseAttackRange = 300; // a monster this close damages the base
 const int kHeroSpeed = 800;
 const int kRadiusOfWind = 1280;
+const int kWindPush = 2200; // how far a wind pushes the monsters
 const int kHerosPerPlayer = 3;
 const int kHeroPhysicAttackRange = 800;
 const int kHeroViewRange = 2200;
@@ -36,7 +60,477 @@ const int kBaseViewRange = 6000;
 const int kMagicManaCost = 10;
 const int kHeroPhysicAttackDmg = 2;
 const int kNumberOfDefenders = 2;
-const int kVeryBigDistance = 40000;
+const int kForgetAfter = 10; // turns without news before an entity is forgotten
+const int kMaxEntities = 256; // what a turn is expected to hold at most (exceeding it only costs allocations)
+const int kMaxActions = 16; // commands queued per turn
+const int kMaxMonsters = 64; // the monsters a turn plays with at most (the nearest to our base)
+const int kInterceptTurnCost = 10; // a turn to intercept a monster near our base, in risk points
+const int kIdleDefenderCost = 1000; // a defender left idle while monsters are near our base
+const int kFarmingTurns = 8; // a defender left at its post while farming, in turns to intercept
+const int kTurnTime = 40000; // us for the decisions of a turn (the referee allows 50 ms)
+const int kMaxCoverBudget = 1 << 24; // sets searched by the cover of a defender, however much time is left
+const int kLookahead = 8; // turns over which plan() checks that a plan keeps our base alive
+
+/*****************************************************************************
+ * Profiling (debug builds only: compile with -DBRAIN_PROFILE)
+ ****************************************************************************/
+#ifdef BRAIN_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+inline uint64_t read_cycle_counter() { return __rdtsc(); }
+#else
+inline uint64_t read_cycle_counter() { return std::chrono::steady_clock::now().time_since_epoch().count(); }
+#endif
+
+// the stages of a turn (the timings are inclusive: the optimiser and the assignment run inside
+// the commanders)
+enum Stage {
+    StageTurn,
+    StageParse,
+    StageFallback,
+    StageClassification,
+    StageDefenders,
+    StageAttacker,
+    StageOptimiser,
+    StageAssignment,
+    StageCommit,
+    StageLookahead,
+    kNumberOfStages
+};
+
+const char * const kStageNames[kNumberOfStages] = {
+    "turn", "parse", "fallback", "classification", "defenders", "attacker", "optimiser", "assignment", "commit", "lookahead"
+};
+
+// Per-stage timings over a rolling window of turns, plus a Chrome trace of the whole run
+class Profiler {
+public:
+    static Profiler & instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    void begin_turn() {
+        m_turnStart = read_cycle_counter();
+    }
+
+    void end_turn() {
+        add(StageTurn, m_turnStart, read_cycle_counter());
+        for (int s = 0; s < kNumberOfStages; ++s) {
+            m_window[s][m_turns % kWindow] = m_current[s];
+            m_current[s] = 0;
+        }
+        ++m_turns;
+    }
+
+    void add(Stage stage, uint64_t start, uint64_t end) {
+        m_current[stage] += end - start;
+        if (m_events.size() < kMaxEvents) {
+            m_events.push_back({ stage, start, end });
+        }
+    }
+
+    // percentiles and log2 histogram (in us) of the time spent per turn in each stage
+    void report(std::ostream & os) const {
+        double scale = cycles_per_us();
+        int n = std::min(m_turns, kWindow);
+        os << "=== profile of the last " << n << " turns (us per turn) ===" << endl;
+        for (int s = 0; s < kNumberOfStages; ++s) {
+            vector<double> samples;
+            for (int i = 0; i < n; ++i) {
+                samples.push_back(m_window[s][i] / scale);
+            }
+            sort(samples.begin(), samples.end());
+            double sum = 0;
+            vector<int> buckets;
+            for (auto us : samples) {
+                sum += us;
+                size_t b = us < 1 ? 0 : 1 + (size_t)std::log2(us);
+                if (buckets.size() <= b) buckets.resize(b + 1, 0);
+                ++buckets[b];
+            }
+            os << kStageNames[s] << ": mean=" << (n ? sum / n : 0);
+            os << "; p50=" << at(samples, 0.5) << "; p99=" << at(samples, 0.99) << "; max=" << at(samples, 1.0);
+            os << "; hist=";
+            for (size_t b = 0; b < buckets.size(); ++b) {
+                if (buckets[b] == 0) continue;
+                os << " <" << (1 << b) << ":" << buckets[b];
+            }
+            os << endl;
+        }
+    }
+
+    // the trace can be loaded by chrome://tracing, Perfetto or speedscope
+    bool export_chrome_trace(const string & path) const {
+        std::ofstream os(path);
+        if (!os) {
+            cerr << "Cannot write the trace to " << path << endl;
+            return false;
+        }
+        double scale = cycles_per_us();
+        os << "{\"traceEvents\":[";
+        for (size_t i = 0; i < m_events.size(); ++i) {
+            const auto & e = m_events[i];
+            os << (i ? ",\n" : "\n");
+            os << "{\"name\":\"" << kStageNames[e.stage] << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0";
+            os << ",\"ts\":" << (e.start - m_originCycles) / scale << ",\"dur\":" << (e.end - e.start) / scale << "}";
+        }
+        os << "]}" << endl;
+        return true;
+    }
+
+private:
+    static constexpr int kWindow = 1024;
+    static constexpr size_t kMaxEvents = 1 << 22;
+
+    struct Event {
+        Stage stage;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    Profiler() :
+        m_turns(0), m_turnStart(0), m_current(),
+        m_originCycles(read_cycle_counter()), m_originTime(std::chrono::steady_clock::now())
+    {
+        for (int s = 0; s < kNumberOfStages; ++s) {
+            m_window[s].assign(kWindow, 0);
+        }
+    }
+
+    // calibrated against the wall clock since the start of the run
+    double cycles_per_us() const {
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - m_originTime;
+        double cycles = read_cycle_counter() - m_originCycles;
+        return elapsed.count() > 0 && cycles > 0 ? cycles / elapsed.count() : 1;
+    }
+
+    static double at(const vector<double> & sorted, double q) {
+        if (sorted.empty()) return 0;
+        return sorted[std::min(sorted.size() - 1, (size_t)(q * sorted.size()))];
+    }
+
+    int m_turns;
+    uint64_t m_turnStart;
+    uint64_t m_current[kNumberOfStages];
+    vector<uint64_t> m_window[kNumberOfStages];
+    vector<Event> m_events;
+    uint64_t m_originCycles;
+    std::chrono::steady_clock::time_point m_originTime;
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Stage stage) : m_stage(stage), m_start(read_cycle_counter()) {}
+    ~ScopedTimer() { Profiler::instance().add(m_stage, m_start, read_cycle_counter()); }
+
+private:
+    Stage m_stage;
+    uint64_t m_start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) ScopedTimer PROFILE_CONCAT(profileTimer, __LINE__)(stage)
+#define PROFILE_TURN_BEGIN() Profiler::instance().begin_turn()
+#define PROFILE_TURN_END() Profiler::instance().end_turn()
+#else
+#define PROFILE_SCOPE(stage) do {} while (0)
+#define PROFILE_TURN_BEGIN() do {} while (0)
+#define PROFILE_TURN_END() do {} while (0)
+#endif
+
+/*****************************************************************************
+ * Memory
+ ****************************************************************************/
+#ifdef BRAIN_COUNT_ALLOCATIONS
+// Debug builds only: count every heap allocation of the process
+size_t g_allocations = 0;
+
+void * operator new(size_t n) {
+    ++g_allocations;
+    if (void * p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete(void * p, size_t) noexcept { std::free(p); }
+#endif
+
+// Bump allocator for the temporaries of a turn: reset in O(1) at the beginning of the next
+// one. Its blocks are kept, so once warmed up a turn does not touch the heap at all.
+class TurnArena {
+public:
+    static constexpr size_t kBlockSize = 1 << 20;
+
+    TurnArena() : m_block(0), m_used(0) {}
+
+    void reset() {
+        m_block = 0;
+        m_used = 0;
+    }
+
+    void * allocate(size_t n, size_t align) {
+        while (true) {
+            if (m_block < m_blocks.size()) {
+                size_t offset = (m_used + align - 1) & ~(align - 1);
+                if (offset + n <= m_blocks[m_block].size) {
+                    m_used = offset + n;
+                    return m_blocks[m_block].data.get() + offset;
+                }
+                if (m_used != 0 || n <= m_blocks[m_block].size) {
+                    ++m_block;
+                    m_used = 0;
+                    continue;
+                }
+            }
+            // warming up (or an oversized request)
+            size_t size = std::max(kBlockSize, n + align);
+            m_blocks.insert(m_blocks.begin() + m_block, Block{ std::unique_ptr<char[]>(new char[size]), size });
+        }
+    }
+
+    // the memory is given back all at once by reset()
+    void deallocate(void *) {}
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    vector<Block> m_blocks;
+    size_t m_block; // the block in use
+    size_t m_used; // in this block
+};
+
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(TurnArena * arena) : m_arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> & other) : m_arena(other.arena()) {}
+
+    T * allocate(size_t n) { return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T * p, size_t) { m_arena->deallocate(p); }
+
+    TurnArena * arena() const { return m_arena; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> & other) const { return m_arena == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> & other) const { return m_arena != other.arena(); }
+
+private:
+    TurnArena * m_arena;
+};
+
+// only valid until the end of the turn
+template <typename T>
+using ArenaVector = vector<T, ArenaAllocator<T>>;
+
+// A FIFO of bounded capacity stored inline
+template <typename T, int N>
+class FixedQueue {
+public:
+    FixedQueue() : m_head(0), m_size(0) {}
+
+    bool empty() const { return m_size == 0; }
+    int size() const { return m_size; }
+    const T & front() const { return m_items[m_head]; }
+
+    void push(const T & item) {
+        if (m_size == N) {
+            cerr << "Warning: queue full; item dropped." << endl;
+            return;
+        }
+        m_items[(m_head + m_size) % N] = item;
+        ++m_size;
+    }
+
+    void pop() {
+        m_head = (m_head + 1) % N;
+        --m_size;
+    }
+
+    void clear() {
+        m_head = 0;
+        m_size = 0;
+    }
+
+private:
+    T m_items[N];
+    int m_head;
+    int m_size;
+};
+
+// A line of text of bounded length stored inline (the command of a hero)
+class CommandLine {
+public:
+    static constexpr int kCapacity = 128;
+
+    CommandLine() : m_len(0) { m_buf[0] = '\0'; }
+
+    void clear() {
+        m_len = 0;
+        m_buf[0] = '\0';
+    }
+
+    bool empty() const { return m_len == 0; }
+    int size() const { return m_len; }
+    const char * c_str() const { return m_buf; }
+
+    CommandLine & operator<<(const char * text) {
+        append(text, std::strlen(text));
+        return *this;
+    }
+
+    CommandLine & operator<<(const string & text) {
+        append(text.data(), text.size());
+        return *this;
+    }
+
+    CommandLine & operator<<(int n) {
+        char digits[16];
+        auto res = std::to_chars(digits, digits + sizeof(digits), n);
+        append(digits, res.ptr - digits);
+        return *this;
+    }
+
+private:
+    // silently truncated to the capacity
+    void append(const char * text, size_t n) {
+        n = std::min(n, (size_t) (kCapacity - 1 - m_len));
+        std::memcpy(m_buf + m_len, text, n);
+        m_len += n;
+        m_buf[m_len] = '\0';
+    }
+
+    char m_buf[kCapacity];
+    int m_len;
+};
+
+/*****************************************************************************
+ * I/O
+ ****************************************************************************/
+// Scans the integers of an input through a large buffer. read() only returns what has
+// already been sent, so it never waits for a turn that the referee has not written yet.
+class InputReader {
+public:
+    static constexpr int kBufferSize = 1 << 16;
+
+    explicit InputReader(int fd = 0) : m_fd(fd), m_cur(m_buf), m_end(m_buf), m_ok(true) {}
+
+    // false at the end of the input (or on a read error)
+    bool ok() const { return m_ok; }
+
+    // whether the next integer has already been read in, at least in part (if not,
+    // next() may have to wait for the input)
+    bool buffered() {
+        while (m_cur != m_end && *m_cur != '-' && (*m_cur < '0' || *m_cur > '9')) ++m_cur;
+        return m_cur != m_end;
+    }
+
+    // the next integer (0 once the input is exhausted); anything else is a separator
+    int next() {
+        int c = skip();
+        bool negative = c == '-';
+        if (negative) c = get();
+        int n = 0;
+        while (c >= '0' && c <= '9') {
+            n = n * 10 + (c - '0');
+            c = get();
+        }
+        return negative ? -n : n;
+    }
+
+private:
+    // the first character of the next number
+    int skip() {
+        int c = get();
+        while (c >= 0 && c != '-' && (c < '0' || c > '9')) c = get();
+        if (c < 0) m_ok = false;
+        return c;
+    }
+
+    // -1 at the end of the input
+    int get() {
+        if (m_cur == m_end && !fill()) return -1;
+        return (unsigned char) *m_cur++;
+    }
+
+    bool fill() {
+        ssize_t n;
+        do {
+            n = ::read(m_fd, m_buf, sizeof(m_buf));
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return false;
+        m_cur = m_buf;
+        m_end = m_buf + n;
+        return true;
+    }
+
+    int m_fd;
+    char m_buf[kBufferSize];
+    const char * m_cur;
+    const char * m_end;
+    bool m_ok;
+};
+
+// The commands of a turn, gathered in place and sent at once
+class OutputBuffer {
+public:
+    static constexpr int kCapacity = kHerosPerPlayer * CommandLine::kCapacity;
+
+    OutputBuffer() : m_len(0) {}
+
+    void append(const CommandLine & line) {
+        if (m_len + line.size() + 1 > kCapacity) {
+            cerr << "Warning: output full; command dropped." << endl;
+            return;
+        }
+        std::memcpy(m_buf + m_len, line.c_str(), line.size());
+        m_len += line.size();
+        m_buf[m_len++] = '\n';
+    }
+
+    // a single write and a single flush
+    void flush(std::ostream & os) {
+        os.write(m_buf, m_len);
+        os.flush();
+        m_len = 0;
+    }
+
+private:
+    char m_buf[kCapacity];
+    int m_len;
+};
+
+/*****************************************************************************
+ * Time
+ ****************************************************************************/
+// The end of the time given to the decisions of a turn. A deadline never started (or started
+// without time) never expires: the decisions then only depend on the input.
+class Deadline {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    Deadline() : m_set(false), m_end() {}
+
+    // micros from now (none if 0)
+    void start(int micros) {
+        m_set = micros > 0;
+        m_end = Clock::now() + std::chrono::microseconds(micros);
+    }
+
+    bool set() const { return m_set; }
+    bool expired() const { return m_set && Clock::now() >= m_end; }
+
+private:
+    bool m_set;
+    Clock::time_point m_end;
+};
 
 /*****************************************************************************
  * Forward declarations
@@ -49,9 +543,8 @@ class Monster;
 class Hero;
 class Brain;
 struct Action;
-class NaiveOptimiser;
+class CircleCoverOptimiser;
 
-vector<Monster> discover_in_range(const vector<Monster> & monsters, Point pos, int range);
 vector<int> discover_in_range(const vector<Hero> & heros, Point pos, int range);
 double convert_degree_to_radian(int degree);
 int convert_radian_to_degree(double theta);
@@ -65,7 +558,7 @@ bool is_upper_area(const Point & ref, const Point & other);
 Point compute_cartesian_point(const Base & base, int r, int angle);
 int other_defencer(int idx);
 vector<Point> find_the_centers(const Point & p, const Point q, int r);
-void cruise_between_angles(Hero & hero, const Base & ref, int radius, int low, int high);
+void cruise_between_angles(Hero & hero, const Base & ref, int radius, int low, int high, bool & goHighPos);
 
 /*****************************************************************************
  * Types
@@ -101,10 +594,27 @@ struct Point {
     }
 };
 
+// the true length (only where a length is needed: the range checks use the predicates below)
 float distance(const Point & a, const Point & b) {
     return std::hypot(a.x - b.x, a.y - b.y);
 }
 
+// The range checks are exact: squared distances on 64 bits, no square root
+long long distance2(const Point & a, const Point & b) {
+    long long dx = a.x - b.x;
+    long long dy = a.y - b.y;
+    return dx * dx + dy * dy;
+}
+
+long long square(int r) {
+    return (long long) r * r;
+}
+
+// |a - b| <= r
+bool within(const Point & a, const Point & b, int r) {
+    return distance2(a, b) <= square(r);
+}
+
 Point operator+(const Point & p1, const Point & p2) {
     return Point(p1.x + p2.x, p1.y + p2.y);
 }
@@ -113,6 +623,10 @@ Point operator-(const Point & p1, const Point & p2) {
     return Point(p1.x - p2.x, p1.y - p2.y);
 }
 
+bool operator==(const Point & p1, const Point & p2) {
+    return p1.x == p2.x && p1.y == p2.y;
+}
+
 std::ostream & operator<<(std::ostream & os, const Point & p) {
     p.display(os);
     return os;
@@ -126,62 +640,412 @@ Point operator/(const Point & p, int div) {
     return Point(p.x / div, p.y / div);
 }
 
+// a vector of the given length pointing from one point to the other (as the referee rounds it)
+Point scale_toward(const Point & from, const Point & to, int len) {
+    float dist = distance(from, to);
+    if (dist == 0) return Point();
+    return Point((to.x - from.x) * len / dist, (to.y - from.y) * len / dist);
+}
+
 // Given two different points P=(x1,x2) and Q=(y1,y2) and a real number r,
 // we want to compute the center of circle that pass through both points with radius r.
 vector<Point> find_the_centers(const Point & p, const Point q, int r) {
-    float dist = distance(p, q);
+    double dist = distance(p, q);
     if (dist == 0) return { p };
 
     if (dist > 2 * r) return {};
 
-    int half = dist / 2;
-    Point mid = (p + q) / 2;
-    if (half == r) return { mid };
+    double half = dist / 2;
+    double mid_x = (p.x + q.x) / 2.0;
+    double mid_y = (p.y + q.y) / 2.0;
 
-    // normalized direction
-    Point dir = Point(p.y - q.y, q.x - p.x) / (int)dist;
+    // normalized direction (perpendicular to PQ)
+    double dir_x = (p.y - q.y) / dist;
+    double dir_y = (q.x - p.x) / dist;
 
-    double lambda = std::sqrt(r * r - half * half);
-    double delta_x = dir.x * lambda;
-    double delta_y = dir.y * lambda;
-    Point delta(delta_x, delta_y);
+    double lambda = std::sqrt(std::max(0.0, (double) r * r - half * half));
+    if (lambda == 0) return { Point(mid_x, mid_y) };
 
-    return { mid + delta, mid - delta };
+    return {
+        Point(std::lround(mid_x + dir_x * lambda), std::lround(mid_y + dir_y * lambda)),
+        Point(std::lround(mid_x - dir_x * lambda), std::lround(mid_y - dir_y * lambda)),
+    };
 }
 
-class NaiveOptimiser {
+class CircleCoverOptimiser {
 public:
-    // find the maximum points enclosed in a circle of r
-    static vector<pair<Point, int>> solve(const vector<Point> & points, int r) {
-        if (points.empty()) return {};
-
-        vector<pair<Point, int>> ans;
-        int n = points.size();
-
-        vector<vector<bool>> visited(n, vector<bool>(n, false));
-        for (int i = 0; i < n; ++i) {
-            for (int j = 0; j < n; ++j) {
-                if (i == j || visited[i][j]) continue;
-
-                visited[i][j] = true;
-                visited[j][i] = true;
-                auto centers = find_the_centers(points[i], points[j], r);
-                for (const auto & c : centers) {
-                    int cnt = 0;
-
-                    for (const auto & p : points) {
-                        int dist = distance(c, p);
-                        if (dist <= r) ++cnt;
-                    }
-                    ans.push_back({c, cnt});
+    CircleCoverOptimiser() : m_cuts(0) { m_events.reserve(2 * kMaxEntities); }
+
+    // the searches stop at the deadline (until the next limit())
+    void limit(const Deadline & deadline) {
+        m_deadline = deadline;
+        m_cuts = 0;
+    }
+
+    // the searches stopped short since limit()
+    int cuts() const { return m_cuts; }
+
+    // Find the center of a circle of radius r enclosing the maximum of points, and this maximum.
+    // On a tie, the center nearest to ref wins.
+    //
+    // Angular sweep: an optimal circle can always be moved until one point (the pivot) lies on
+    // its border. Around a pivot, the point j is enclosed while the angle of the center is in
+    // [a - b, a + b] (a: the angle from the pivot to j, b = acos(d / 2r)). Sorting these
+    // intervals and sweeping them gives the best circle of each pivot: O(n^2 log n).
+    // The angles are compared as pseudo-angles of the unit vectors, so no trigonometry is needed.
+    // The events buffer is kept from one call to the next. Past the deadline, the best circle
+    // of the pivots done so far is returned.
+    template <typename Points>
+    pair<Point, int> solve(const Points & points, int r, const Point & ref) {
+        PROFILE_SCOPE(StageOptimiser);
+        if (points.empty()) return { ref, 0 };
+
+        // the center is rounded to integers: keep a margin so that the border points stay in
+        double radius = r - 1;
+        pair<Point, int> best = { points.front(), 0 };
+        long long bestDist = 0;
+        auto consider = [&](const Point & pivot, double ux, double uy, int cnt) {
+            if (cnt < best.second) return;
+            Point c(std::lround(pivot.x + radius * ux), std::lround(pivot.y + radius * uy));
+            long long dist = distance2(c, ref);
+            if (cnt > best.second || dist < bestDist) {
+                best = { c, cnt };
+                bestDist = dist;
+            }
+        };
+
+        auto & events = m_events;
+        events.reserve(2 * points.size());
+        for (const auto & pivot : points) {
+            if (&pivot != &points.front() && m_deadline.expired()) {
+                ++m_cuts;
+                break;
+            }
+            events.clear();
+            int cnt = 1;
+            for (const auto & q : points) {
+                if (&q == &pivot) continue;
+
+                double dx = q.x - pivot.x;
+                double dy = q.y - pivot.y;
+                double d2 = dx * dx + dy * dy;
+                if (d2 > 4 * radius * radius) continue;
+                if (d2 == 0) {
+                    ++cnt;
+                    continue;
+                }
+
+                double d = std::sqrt(d2);
+                double ux = dx / d;
+                double uy = dy / d;
+                double cosb = d / (2 * radius);
+                double sinb = std::sqrt(std::max(0.0, 1 - cosb * cosb));
+                // the directions of the center (from the pivot) rotated by -b and +b
+                Event enter = { 0, +1, ux * cosb + uy * sinb, uy * cosb - ux * sinb };
+                Event leave = { 0, -1, ux * cosb - uy * sinb, uy * cosb + ux * sinb };
+                enter.angle = pseudo_angle(enter.ux, enter.uy);
+                leave.angle = pseudo_angle(leave.ux, leave.uy);
+                // the interval wraps around 0: enclosed from the beginning of the sweep
+                if (enter.angle > leave.angle) ++cnt;
+                events.push_back(enter);
+                events.push_back(leave);
+            }
+            // enter before leave at the same angle: the border is inclusive
+            sort(events.begin(), events.end(), [](const Event & e1, const Event & e2) {
+                if (e1.angle != e2.angle) return e1.angle < e2.angle;
+                return e1.delta > e2.delta;
+            });
+
+            consider(pivot, 1, 0, cnt);
+            for (const auto & e : events) {
+                cnt += e.delta;
+                if (e.delta > 0) consider(pivot, e.ux, e.uy, cnt);
+            }
+        }
+        return best;
+    }
+
+private:
+    struct Event {
+        double angle; // pseudo-angle
+        int delta; // +1 enter, -1 leave
+        double ux; // unit vector from the pivot to the center
+        double uy;
+    };
+
+    // a monotonic substitute of the angle of (x, y) in [0, 4)
+    static double pseudo_angle(double x, double y) {
+        if (y >= 0) {
+            return x >= 0 ? y / (x + y) : 1 - x / (y - x);
+        }
+        return x < 0 ? 2 - y / (-x - y) : 3 + x / (x - y);
+    }
+
+    vector<Event> m_events;
+    Deadline m_deadline;
+    int m_cuts;
+};
+
+// Places up to kMaxCircles circles of radius r at once (each one the attack range of a hero)
+// to maximise the weighted damage: a point enclosed by k circles is worth its weight times
+// min(k, its cap), the cap being the hits it can take before dying. Circles already placed can
+// be given: the new ones are planned around them.
+//
+// The candidate centers are shared by all the circles: the points themselves, and the centers
+// of the circles through every pair of points (an optimal circle can always be moved until two
+// points lie on its border). Candidates enclosing the same points are merged, and the sets of
+// circles are searched by decreasing weights, cut as soon as the weights left cannot beat the
+// best plan. The search stops after a budget of sets (kBudget unless limit() says otherwise) or
+// at a deadline, keeping the best plan found (which starts as the greedy one), so its time is
+// bounded whatever the points.
+class JointCoverOptimiser {
+public:
+    static constexpr int kMaxPoints = 32; // the heaviest ones are kept
+    static constexpr int kMaxCircles = kHerosPerPlayer; // given ones included
+    static constexpr int kBudget = 20000;
+    static constexpr int kHashBits = 11; // more than twice the candidates
+    static constexpr int kHashSize = 1 << kHashBits;
+
+    struct Plan {
+        int circles;
+        int weight; // the weighted damage of all the circles (the given ones included)
+        Point centers[kMaxCircles];
+        uint64_t enclosed[kMaxCircles]; // the indices of the points, by circle
+    };
+
+    JointCoverOptimiser() : m_limit(kBudget), m_cuts(0) {
+        m_candidates.reserve(kMaxPoints * kMaxPoints);
+        m_order.reserve(kMaxPoints);
+    }
+
+    // the searches stop after this many sets or at the deadline (until the next limit())
+    void limit(int budget, const Deadline & deadline) {
+        m_limit = budget;
+        m_deadline = deadline;
+        m_cuts = 0;
+    }
+
+    // the searches stopped short since limit()
+    int cuts() const { return m_cuts; }
+
+    // On a tie, the plan whose centers are the nearest to ref wins.
+    template <typename Points, typename Weights, typename Caps>
+    Plan solve(const Points & points, const Weights & weights, const Caps & caps, int circles, int r,
+               const Point & ref, const Point * given = nullptr, int givenCount = 0) {
+        PROFILE_SCOPE(StageOptimiser);
+        Plan plan = {};
+        givenCount = std::min(givenCount, kMaxCircles - 1);
+        plan.circles = std::min(circles, kMaxCircles - givenCount);
+        select(points, weights, caps);
+        if (m_order.empty() || plan.circles <= 0) return plan;
+
+        generate(points, r, ref);
+        Coverage start = {};
+        for (int g = 0; g < givenCount; ++g) start = start.add(enclosed(points, given[g], r));
+        plan.weight = -1;
+        m_budget = m_limit;
+        // the greedy plan first: a bound to cut the search, and the answer if the budget is short
+        Coverage greedy = start;
+        for (int c = 0; c < plan.circles; ++c) {
+            int best = 0;
+            for (int i = 1; i < (int) m_candidates.size(); ++i) {
+                if (value(greedy.add(m_candidates[i].mask)) > value(greedy.add(m_candidates[best].mask))) best = i;
+            }
+            m_chosen[c] = best;
+            greedy = greedy.add(m_candidates[best].mask);
+        }
+        keep(plan, value(greedy));
+        search(plan, 0, 0, start);
+        if (m_budget <= 0) ++m_cuts;
+        for (int c = 0; c < plan.circles; ++c) {
+            const auto & candidate = m_candidates[m_best[c]];
+            plan.centers[c] = candidate.center;
+            // back to the indices of the caller
+            plan.enclosed[c] = 0;
+            for (uint64_t m = candidate.mask; m != 0; m &= m - 1) {
+                plan.enclosed[c] |= 1ull << m_order[__builtin_ctzll(m)];
+            }
+        }
+        return plan;
+    }
+
+private:
+    struct Candidate {
+        Point center;
+        uint64_t mask; // by rank in m_order
+        int weight;
+        long long dist; // to ref
+    };
+
+    struct HashSlot {
+        unsigned stamp; // of the solve which filled it
+        int index; // in m_candidates
+    };
+
+    // the points enclosed at least once, twice, ... (by rank)
+    struct Coverage {
+        uint64_t atLeast[kMaxCircles];
+
+        Coverage add(uint64_t mask) const {
+            Coverage c = *this;
+            for (int k = kMaxCircles - 1; k > 0; --k) c.atLeast[k] |= atLeast[k - 1] & mask;
+            c.atLeast[0] |= mask;
+            return c;
+        }
+    };
+
+    // the heaviest points (at most kMaxPoints of the first 64), by index
+    template <typename Points, typename Weights, typename Caps>
+    void select(const Points & points, const Weights & weights, const Caps & caps) {
+        m_order.clear();
+        for (int i = 0; i < (int) points.size() && i < 64; ++i) {
+            if (weights[i] > 0 && caps[i] > 0) m_order.push_back(i);
+        }
+        if ((int) m_order.size() > kMaxPoints) {
+            stable_sort(m_order.begin(), m_order.end(), [&](int a, int b) { return weights[a] > weights[b]; });
+            m_order.resize(kMaxPoints);
+        }
+        for (auto & m : m_capped) m = 0;
+        for (auto & table : m_bytes) std::fill(table, table + 256, 0);
+        for (int k = 0; k < (int) m_order.size(); ++k) {
+            for (int c = 0; c < kMaxCircles && c < caps[m_order[k]]; ++c) m_capped[c] |= 1ull << k;
+            // the weight of every byte of a mask
+            int w = weights[m_order[k]];
+            auto & table = m_bytes[k / 8];
+            int bit = 1 << (k % 8);
+            for (int b = bit; b < 256; b = (b + 1) | bit) table[b] += w;
+        }
+    }
+
+    // the points of among (by rank) enclosed by the circle
+    template <typename Points>
+    uint64_t enclosed(const Points & points, const Point & c, int r, uint64_t among = ~0ull) const {
+        uint64_t mask = 0;
+        for (among &= (m_order.size() < 64 ? (1ull << m_order.size()) - 1 : ~0ull); among != 0; among &= among - 1) {
+            int k = __builtin_ctzll(among);
+            if (within(c, points[m_order[k]], r)) mask |= 1ull << k;
+        }
+        return mask;
+    }
+
+    template <typename Points>
+    void generate(const Points & points, int r, const Point & ref) {
+        m_candidates.clear();
+        int n = m_order.size();
+        // the centers are rounded to integers: keep a margin so that the border points stay in
+        double radius = r - 1;
+        // a circle through a point only encloses the points within 2r of it
+        uint64_t near[kMaxPoints] = {};
+        for (int a = 0; a < n; ++a) {
+            for (int b = a; b < n; ++b) {
+                if (!within(points[m_order[a]], points[m_order[b]], 2 * r)) continue;
+                near[a] |= 1ull << b;
+                near[b] |= 1ull << a;
+            }
+        }
+        // one candidate (the nearest to ref) per set of points, found by hashing
+        ++m_stamp;
+        auto add = [&](const Point & c, int a) {
+            uint64_t mask = enclosed(points, c, r, near[a]);
+            long long dist = distance2(c, ref);
+            unsigned h = (mask * 0x9E3779B97F4A7C15ull) >> (64 - kHashBits);
+            for (;; h = (h + 1) & (kHashSize - 1)) {
+                auto & slot = m_hash[h];
+                if (slot.stamp != m_stamp) {
+                    slot.stamp = m_stamp;
+                    slot.index = m_candidates.size();
+                    m_candidates.push_back(Candidate{ c, mask, weight(mask), dist });
+                    return;
+                }
+                auto & known = m_candidates[slot.index];
+                if (known.mask != mask) continue;
+                if (dist < known.dist) {
+                    known.center = c;
+                    known.dist = dist;
                 }
+                return;
+            }
+        };
+        for (int a = 0; a < n; ++a) {
+            const Point & p = points[m_order[a]];
+            add(p, a);
+            for (uint64_t others = near[a] >> a >> 1; others != 0; others &= others - 1) {
+                int b = a + 1 + __builtin_ctzll(others);
+                const Point & q = points[m_order[b]];
+                double dx = q.x - p.x;
+                double dy = q.y - p.y;
+                double d2 = dx * dx + dy * dy;
+                if (d2 == 0 || d2 > 4 * radius * radius) continue;
+
+                double d = std::sqrt(d2);
+                double lambda = std::sqrt(std::max(0.0, radius * radius - d2 / 4)) / d;
+                double mx = (p.x + q.x) / 2.0;
+                double my = (p.y + q.y) / 2.0;
+                add(Point(std::lround(mx - dy * lambda), std::lround(my + dx * lambda)), a);
+                add(Point(std::lround(mx + dy * lambda), std::lround(my - dx * lambda)), a);
             }
         }
-        sort(ans.begin(), ans.end(), [] (const auto & p1, const auto & p2) {
-            return p1.second > p2.second;
+        // the heaviest first
+        sort(m_candidates.begin(), m_candidates.end(), [](const Candidate & a, const Candidate & b) {
+            if (a.weight != b.weight) return a.weight > b.weight;
+            return a.mask < b.mask;
         });
-        return ans;
     }
+
+    int weight(uint64_t mask) const {
+        return m_bytes[0][mask & 255] + m_bytes[1][(mask >> 8) & 255]
+             + m_bytes[2][(mask >> 16) & 255] + m_bytes[3][(mask >> 24) & 255];
+    }
+
+    int value(const Coverage & c) const {
+        int w = 0;
+        for (int k = 0; k < kMaxCircles; ++k) w += weight(c.atLeast[k] & m_capped[k]);
+        return w;
+    }
+
+    // the circles c and after, among the candidates from i (a candidate may be taken again: the
+    // damages add up)
+    void search(Plan & plan, int c, int i, const Coverage & taken) {
+        if (c == plan.circles) {
+            keep(plan, value(taken));
+            return;
+        }
+        int left = plan.circles - c;
+        int now = value(taken);
+        for (; i < (int) m_candidates.size() && m_budget > 0; ++i) {
+            --m_budget;
+            // the clock is read every 64 sets
+            if ((m_budget & 63) == 0 && m_deadline.expired()) m_budget = 0;
+            // the candidates are by decreasing weights: nothing better from here
+            if (now + left * m_candidates[i].weight < plan.weight) break;
+            m_chosen[c] = i;
+            search(plan, c + 1, i, taken.add(m_candidates[i].mask));
+        }
+    }
+
+    void keep(Plan & plan, int w) {
+        long long dist = 0;
+        for (int c = 0; c < plan.circles; ++c) dist += m_candidates[m_chosen[c]].dist;
+        if (w > plan.weight || (w == plan.weight && dist < m_bestDist)) {
+            plan.weight = w;
+            m_bestDist = dist;
+            std::copy(m_chosen, m_chosen + plan.circles, m_best);
+        }
+    }
+
+    vector<int> m_order; // rank => index of the point
+    int m_bytes[kMaxPoints / 8][256]; // the weights of the points of a byte of a mask
+    uint64_t m_capped[kMaxCircles]; // the points worth a k+1-th hit (by rank)
+    vector<Candidate> m_candidates;
+    HashSlot m_hash[kHashSize] = {};
+    unsigned m_stamp = 0;
+    int m_chosen[kMaxCircles];
+    int m_best[kMaxCircles];
+    long long m_bestDist;
+    int m_budget; // sets left
+    int m_limit;
+    Deadline m_deadline;
+    int m_cuts;
 };
 
 enum Command {
@@ -228,11 +1092,11 @@ struct Action {
                 verbName = "???";
                 break;
         }
-        cerr << "Action: subject(idx)=" << subject;
-        cerr << "; verb=" << verbName;
-        cerr << "; object(id)=" << object;
-        cerr << "; dest=" << dest;
-        cerr << "; msg=" << msg;
+        os << "Action: subject(idx)=" << subject;
+        os << "; verb=" << verbName;
+        os << "; object(id)=" << object;
+        os << "; dest=" << dest;
+        os << "; msg=" << msg;
     }
 };
 
@@ -241,6 +1105,16 @@ std::ostream & operator<<(std::ostream & os, const Action & a) {
     return os;
 }
 
+// The command of a hero as sent to the referee (in the real map)
+struct Order {
+    Command verb;
+    int object; // id of the object
+    Point dest;
+
+    Order() : verb(WAIT), object(0), dest() {}
+    Order(Command v, int o, const Point & p) : verb(v), object(o), dest(p) {}
+};
+
 struct RadialPoint {
     Point orig;
     int radius;
@@ -266,22 +1140,175 @@ int convert_radian_to_degree(double radian) {
     return 180 * radian / pi;
 }
 
-bool is_bottom_lane(const Point & ref, const Point & other) {
-    int degree = calc_degree_between(ref, other);
-    if (degree < k30Degree) return true;
-    return false;
+// The trigonometry of the integer degrees, computed once.
+//
+// The sines and the cosines are those of the range the bot uses (one turn each side), with
+// the very same expression as before, so the polar points do not move by a unit. The degree
+// between two points (the truncated atan of the slope dy / dx) is found by comparing the
+// slope to the smallest slope of each degree. Since the original formula is monotonic in the
+// slope, these thresholds are found by bisection against it. Each one is then kept as the
+// smallest fraction rise / run (run up to kMaxRun) at or past it, and a slope dy / dx is
+// compared by cross-products in 64 bits, dy * run against dx * rise: no slope with dx up to
+// kMaxRun lies in between, so the result is that of the formula on the whole map.
+class TrigTables {
+public:
+    static constexpr int kMinAngle = -360;
+    static constexpr int kMaxAngle = 720;
+    static constexpr int kMinDegree = -89; // of a slope
+    static constexpr int kMaxDegree = 89;
+
+    TrigTables() {
+        for (int a = kMinAngle; a < kMaxAngle; ++a) {
+            double theta = convert_degree_to_radian(a);
+            m_cos[a - kMinAngle] = std::cos(theta);
+            m_sin[a - kMinAngle] = std::sin(theta);
+        }
+        for (int d = kMinDegree + 1; d <= kMaxDegree; ++d) {
+            m_threshold[d - kMinDegree] = smallest_fraction(smallest_slope(d));
+        }
+    }
+
+    double cos(int angle) const {
+        if (angle < kMinAngle || angle >= kMaxAngle) return std::cos(convert_degree_to_radian(angle));
+        return m_cos[angle - kMinAngle];
+    }
+
+    double sin(int angle) const {
+        if (angle < kMinAngle || angle >= kMaxAngle) return std::sin(convert_degree_to_radian(angle));
+        return m_sin[angle - kMinAngle];
+    }
+
+    static constexpr long long kMaxRun = 1 << 15; // past any dx on the map
+
+    // whether the degree of the slope dy / dx (dx >= 0) is at least d
+    bool at_least(long long dx, long long dy, int d) const {
+        if (d <= kMinDegree) return true;
+        if (d > kMaxDegree) return false;
+        const auto & x = m_threshold[d - kMinDegree];
+        return dy * x.run >= dx * x.rise;
+    }
+
+    // the degree of the slope dy / dx (dx > 0), by binary search
+    int degree(long long dx, long long dy) const {
+        int low = kMinDegree;
+        int high = kMaxDegree;
+        while (low < high) {
+            int mid = low + (high - low + 1) / 2;
+            if (at_least(dx, dy, mid)) {
+                low = mid;
+            } else {
+                high = mid - 1;
+            }
+        }
+        return low;
+    }
+
+private:
+    // the original formula
+    static int atan_degree(double slope) {
+        return convert_radian_to_degree(std::atan(slope));
+    }
+
+    struct Fraction {
+        long long rise;
+        long long run;
+
+        Fraction plus(long long k, const Fraction & f) const { return { rise + k * f.rise, run + k * f.run }; }
+    };
+
+    // The smallest fraction (run up to kMaxRun) the original comparison puts at or past the
+    // slope, by a walk down the Stern-Brocot tree: lo and hi are neighbours, below and at or
+    // past the slope, and each one moves toward the other as far as it stays on its side.
+    static Fraction smallest_fraction(double slope) {
+        auto past = [&](const Fraction & f) { return (double) f.rise / f.run >= slope; };
+        // the largest k in [0, max] for which past(from.plus(k, to)) is as wanted
+        auto steps = [&](const Fraction & from, const Fraction & to, bool wanted) {
+            long long low = 0;
+            long long high = (kMaxRun - from.run) / to.run;
+            while (low < high) {
+                long long mid = low + (high - low + 1) / 2;
+                if (past(from.plus(mid, to)) == wanted) {
+                    low = mid;
+                } else {
+                    high = mid - 1;
+                }
+            }
+            return low;
+        };
+        Fraction lo = { (long long) std::floor(slope) - 1, 1 };
+        while (!past(lo.plus(1, { 1, 0 }))) ++lo.rise;
+        Fraction hi = { lo.rise + 1, 1 };
+        while (true) {
+            long long j = steps(hi, lo, true);
+            hi = hi.plus(j, lo);
+            long long k = steps(lo, hi, false);
+            lo = lo.plus(k, hi);
+            if (j == 0 && k == 0) return hi;
+        }
+    }
+
+    static double smallest_slope(int d) {
+        double lo = -1e18; // atan_degree(lo) < d
+        double hi = 1e18; // atan_degree(hi) >= d
+        while (true) {
+            double mid = lo + (hi - lo) / 2;
+            if (mid == lo || mid == hi) return hi;
+            if (atan_degree(mid) >= d) {
+                hi = mid;
+            } else {
+                lo = mid;
+            }
+        }
+    }
+
+    double m_cos[kMaxAngle - kMinAngle];
+    double m_sin[kMaxAngle - kMinAngle];
+    Fraction m_threshold[kMaxDegree - kMinDegree + 1]; // the smallest slope of each degree
+};
+
+const TrigTables kTrig;
+
+// The degree of other seen from ref, as the truncated atan of the slope (in (-90, 90),
+// 90 or 0 on a vertical line). The slope is kept as dy / dx with dx >= 0.
+class Direction {
+public:
+    Direction(const Point & ref, const Point & other) :
+        m_dx(other.x - ref.x), m_dy(other.y - ref.y) {
+        if (m_dx < 0) {
+            m_dx = -m_dx;
+            m_dy = -m_dy;
+        }
+    }
+
+    int degree() const {
+        if (m_dx == 0) return m_dy >= 0 ? 90 : 0;
+        return kTrig.degree(m_dx, m_dy);
+    }
+
+    // degree() >= d, for d in [1, 89] (which holds on a vertical line as well)
+    bool at_least(int d) const {
+        return kTrig.at_least(m_dx, m_dy, d);
+    }
+
+private:
+    long long m_dx;
+    long long m_dy;
+};
+
+bool is_bottom_lane(const Point & ref, const Point & other) {
+    // degree < 30
+    return !Direction(ref, other).at_least(k30Degree);
 }
 
 bool is_mid_lane(const Point & ref, const Point & other) {
-    int degree = calc_degree_between(ref, other);
-    if (degree > k30Degree && degree < k60Degree) return true;
-    return false;
+    // 30 < degree < 60
+    Direction dir(ref, other);
+    return dir.at_least(k30Degree + 1) && !dir.at_least(k60Degree);
 }
 
 bool is_top_lane(const Point & ref, const Point & other) {
-    int degree = calc_degree_between(ref, other);
-    if (degree >= k60Degree) return true;
-    return false;
+    // degree >= 60
+    return Direction(ref, other).at_least(k60Degree);
 }
 
 bool is_upper_area(const Point & ref, const Point & other) {
@@ -289,25 +1316,17 @@ bool is_upper_area(const Point & ref, const Point & other) {
 }
 
 bool is_lower_area(const Point & ref, const Point & other) {
-    int degree = calc_degree_between(ref, other);
-    if (degree <= k45Degree) return true;
-    return false;
+    // degree <= 45
+    return !Direction(ref, other).at_least(k45Degree + 1);
 }
 
 int calc_degree_between(const Point & ref, const Point & other) {
-    int delta_x = other.x - ref.x;
-    int delta_y = other.y - ref.y;
-    if (delta_x == 0) {
-        return delta_y >= 0 ? 90 : 0;
-    }
-    double theta = std::atan((double) delta_y / delta_x);
-    return convert_radian_to_degree(theta);
+    return Direction(ref, other).degree();
 }
 
 Point convert_polar_to_cartesian(const RadialPoint & rp) {
-    double theta = convert_degree_to_radian(rp.angle);
-    double delta_x = rp.radius * std::cos(theta);
-    double detta_y = rp.radius * std::sin(theta);
+    double delta_x = rp.radius * kTrig.cos(rp.angle);
+    double detta_y = rp.radius * kTrig.sin(rp.angle);
     Point p = rp.orig + Point(delta_x, detta_y);
     return p;
 }
@@ -349,53 +1368,1040 @@ public:
     int threat; // Given this monster's trajectory, is it a threat to 1=your base, 2=your opponent's base, 0=neither
 };
 
-class Monster : public Entity {
+// Brain always plays from the top-left corner (the blue side). When it plays the red side,
+// what comes in is rotated by 180 degrees around the center of the map, and so are the
+// points of its commands on the way out (the rotation is its own inverse).
+class Frame {
+public:
+    explicit Frame(bool rotated = false) : m_rotated(rotated) {}
+
+    // the frame of the player whose base is there (in the real map)
+    static Frame of(const Point & base) { return Frame(base.x != 0); }
+
+    Point point(const Point & p) const {
+        return m_rotated ? Point(kWidth - p.x, kHeight - p.y) : p;
+    }
+
+    Point velocity(const Point & v) const {
+        return m_rotated ? Point(-v.x, -v.y) : v;
+    }
+
+    Entity entity(Entity e) const {
+        e.pos = point(e.pos);
+        e.v = velocity(e.v);
+        return e;
+    }
+
+private:
+    bool m_rotated;
+};
+
+// the corners of the bases in the canonical frame
+const Point kOurCorner(0, 0);
+const Point kTheirCorner(kWidth, kHeight);
+
+// A stable reference to an entity of an EntityStore. Once the entity is evicted, the
+// handle is detected as stale even if its slot has been reused since.
+struct EntityHandle {
+    int slot;
+    unsigned generation;
+
+    EntityHandle() : slot(-1), generation(0) {}
+    EntityHandle(int s, unsigned g) : slot(s), generation(g) {}
+};
+
+// The last known state of the entities, stored densely: O(1) lookups by id (through an
+// id-indexed table of slots) or by handle. The entities not seen for a while are evicted
+// and their slots recycled, so that the memory stays bounded over a whole match.
+//
+// The heros keep their ids (the lowest ones) for the whole match and have a table of their
+// own: the table of the other ids only spans the monsters seen lately.
+class EntityStore {
+public:
+    static constexpr int kHeroIds = 2 * kHerosPerPlayer; // the ids below are those of the heros
+
+    EntityStore() : m_turn(0), m_firstId(0) {
+        std::fill(m_heroIndex, m_heroIndex + kHeroIds, -1);
+        m_slots.reserve(kMaxEntities);
+        m_free.reserve(kMaxEntities);
+        // the span of the ids seen lately
+        m_index.reserve(4 * kMaxEntities);
+    }
+
+    void begin_turn() { ++m_turn; }
+
+    // insert or refresh an entity seen this turn
+    EntityHandle put(const Entity & e) {
+        int slot = slot_of(e.id);
+        if (slot < 0) {
+            slot = allocate();
+            index(e.id, slot);
+        }
+        auto & s = m_slots[slot];
+        s.entity = e;
+        s.lastSeen = m_turn;
+        return EntityHandle(slot, s.generation);
+    }
+
+    bool valid(EntityHandle h) const {
+        return h.slot >= 0 && h.slot < (int) m_slots.size()
+            && m_slots[h.slot].alive && m_slots[h.slot].generation == h.generation;
+    }
+
+    const Entity & get(EntityHandle h) const {
+        return m_slots[h.slot].entity;
+    }
+
+    // a stale handle if unknown
+    EntityHandle find(int id) const {
+        int slot = slot_of(id);
+        if (slot < 0) return EntityHandle();
+        return EntityHandle(slot, m_slots[slot].generation);
+    }
+
+    // the turn the entity was seen for the last time
+    int last_seen(EntityHandle h) const {
+        return m_slots[h.slot].lastSeen;
+    }
+
+    // forget the entities not seen during the last maxAge turns
+    void evict(int maxAge) {
+        for (int slot = 0; slot < (int) m_slots.size(); ++slot) {
+            auto & s = m_slots[slot];
+            if (!s.alive || m_turn - s.lastSeen < maxAge) continue;
+
+            s.alive = false;
+            ++s.generation;
+            unindex(s.entity.id);
+            m_free.push_back(slot);
+        }
+        // the ids of the monsters keep growing: drop the head of the table once it is mostly empty
+        size_t head = 0;
+        while (head < m_index.size() && m_index[head] < 0) ++head;
+        if (head >= 64 && 2 * head >= m_index.size()) {
+            m_index.erase(m_index.begin(), m_index.begin() + head);
+            m_firstId += head;
+        }
+    }
+
+    // the number of entities known
+    int size() const { return m_slots.size() - m_free.size(); }
+
+    // the slots in use are below
+    int capacity() const { return m_slots.size(); }
+
+    // the ids spanned by the table of the monsters
+    int span() const { return m_index.size(); }
+
+private:
+    struct Slot {
+        Entity entity;
+        unsigned generation;
+        int lastSeen;
+        bool alive;
+    };
+
+    int slot_of(int id) const {
+        if (id >= 0 && id < kHeroIds) return m_heroIndex[id];
+        int k = id - m_firstId;
+        if (k < 0 || k >= (int) m_index.size()) return -1;
+        return m_index[k];
+    }
+
+    int allocate() {
+        if (!m_free.empty()) {
+            int slot = m_free.back();
+            m_free.pop_back();
+            m_slots[slot].alive = true;
+            return slot;
+        }
+        m_slots.push_back(Slot{ Entity{}, 0, 0, true });
+        return m_slots.size() - 1;
+    }
+
+    void index(int id, int slot) {
+        if (id >= 0 && id < kHeroIds) {
+            m_heroIndex[id] = slot;
+            return;
+        }
+        if (m_index.empty()) m_firstId = id;
+        if (id < m_firstId) {
+            m_index.insert(m_index.begin(), m_firstId - id, -1);
+            m_firstId = id;
+        }
+        if (id - m_firstId >= (int) m_index.size()) m_index.resize(id - m_firstId + 1, -1);
+        m_index[id - m_firstId] = slot;
+    }
+
+    void unindex(int id) {
+        if (id >= 0 && id < kHeroIds) {
+            m_heroIndex[id] = -1;
+        } else {
+            m_index[id - m_firstId] = -1;
+        }
+    }
+
+    int m_turn;
+    int m_firstId;
+    int m_heroIndex[kHeroIds]; // id => slot (-1 if unknown)
+    vector<Slot> m_slots;
+    vector<int> m_free; // recycled slots
+    vector<int> m_index; // id - m_firstId => slot (-1 if unknown)
+};
+
+class Monster : public Entity {
+public:
+    Monster(Entity e): Entity(e) {}
+
+    void display(std::ostream & os) const {
+        os << "Monster " << id << ": ";
+        os << "hp=" << hp;
+        os << "; pos=" << pos;
+        os << "; v=" << v;
+    }
+
+    // How many turns to reach to the destination point (-1 if it leaves the map before)
+    //
+    // Same result as walking the trajectory (curr += v) until the monster is in the radius of
+    // the base, in constant time: the first turn in the radius is the smallest root k of
+    // |pos + k * v - base|^2 = R^2, and the turn it leaves the map is solved per axis.
+    int eta(const Base & base) const {
+        return eta(base, turns_in_map());
+    }
+
+    // The same, knowing the result of turns_in_map()
+    int eta(const Base & base, int inMap) const {
+        if (inMap == 0) return -1;
+
+        double dx = pos.x - base.pos.x;
+        double dy = pos.y - base.pos.y;
+        double a = (double) v.x * v.x + (double) v.y * v.y;
+        double b = 2 * (dx * v.x + dy * v.y);
+        double c = dx * dx + dy * dy - (double) kRadiusOfBase * kRadiusOfBase;
+        int k = 0;
+        if (!reached(base, 0)) {
+            double delta = b * b - 4 * a * c;
+            if (a == 0 || delta < 0) return -1;
+            double sq = std::sqrt(delta);
+            if ((-b + sq) / (2 * a) < 0) return -1; // moving away
+            k = std::max(1, (int) std::ceil((-b - sq) / (2 * a)));
+            // the root is not exact: settle the boundary turn with the exact predicate
+            while (k > 1 && reached(base, k - 1)) --k;
+            while (k < inMap && !reached(base, k)) ++k;
+        }
+        if (k >= inMap) return -1;
+
+        int ans = k;
+        float dist = distance(base.pos, at(k));
+        ans += dist / kMonsterSpeed;
+        return ans;
+    }
+
+    // The number of turns before leaving the map (0 if already out, INT_MAX if never)
+    int turns_in_map() const {
+        if (!pos.valid()) return 0;
+        return std::min(turns_on_axis(pos.x, v.x, kWidth), turns_on_axis(pos.y, v.y, kHeight));
+    }
+
+    // the position in k turns (on a straight line)
+    Point at(int k) const {
+        return Point(pos.x + k * v.x, pos.y + k * v.y);
+    }
+
+private:
+    bool reached(const Base & base, int k) const {
+        return within(base.pos, at(k), kRadiusOfBase);
+    }
+
+    // first k such that x + k * vx is out of [0, high]
+    static int turns_on_axis(int x, int vx, int high) {
+        if (vx > 0) return (high - x) / vx + 1;
+        if (vx < 0) return x / -vx + 1;
+        return std::numeric_limits<int>::max();
+    }
+};
+
+std::ostream & operator<<(std::ostream & os, const Monster & m) {
+    m.display(os);
+    return os;
+}
+
+// A set of monsters of the turn, one bit per row of the monster table. The rows of the
+// first kMaxEntities monsters are stored inline, the others (a crowded turn) in words
+// allocated on demand.
+class MonsterMask {
+public:
+    static constexpr int kWords = kMaxEntities / 64; // inline
+
+    MonsterMask() { clear(); }
+
+    // the capacity of the words beyond is kept
+    void clear() {
+        std::fill(m_words, m_words + kWords, 0);
+        m_more.clear();
+    }
+
+    void set(int i) {
+        word(i >> 6) |= 1ull << (i & 63);
+    }
+
+    // the bits [i, i + 8) (i: a multiple of 8)
+    void set_lanes(int i, unsigned bits) {
+        if (bits & 0xff) word(i >> 6) |= (uint64_t) (bits & 0xff) << (i & 63);
+    }
+
+    bool test(int i) const {
+        return (word(i >> 6) >> (i & 63)) & 1;
+    }
+
+    int count() const {
+        int ans = 0;
+        for (auto w : m_words) ans += __builtin_popcountll(w);
+        for (auto w : m_more) ans += __builtin_popcountll(w);
+        return ans;
+    }
+
+    bool any() const {
+        for (auto w : m_words) {
+            if (w) return true;
+        }
+        for (auto w : m_more) {
+            if (w) return true;
+        }
+        return false;
+    }
+
+    MonsterMask operator&(const MonsterMask & other) const {
+        MonsterMask ans;
+        for (int k = 0; k < kWords; ++k) ans.m_words[k] = m_words[k] & other.m_words[k];
+        size_t more = std::min(m_more.size(), other.m_more.size());
+        if (more > 0) ans.m_more.resize(more);
+        for (size_t k = 0; k < more; ++k) ans.m_more[k] = m_more[k] & other.m_more[k];
+        return ans;
+    }
+
+    // call f(row) for every monster of the set, in ascending order
+    template <typename F>
+    void for_each(F f) const {
+        for (int k = 0; k < kWords; ++k) {
+            for (uint64_t w = m_words[k]; w != 0; w &= w - 1) f(64 * k + __builtin_ctzll(w));
+        }
+        for (int k = 0; k < (int) m_more.size(); ++k) {
+            for (uint64_t w = m_more[k]; w != 0; w &= w - 1) f(64 * (kWords + k) + __builtin_ctzll(w));
+        }
+    }
+
+private:
+    uint64_t & word(int k) {
+        if (k < kWords) return m_words[k];
+        k -= kWords;
+        if (k >= (int) m_more.size()) m_more.resize(k + 1, 0);
+        return m_more[k];
+    }
+
+    uint64_t word(int k) const {
+        if (k < kWords) return m_words[k];
+        k -= kWords;
+        return k < (int) m_more.size() ? m_more[k] : 0;
+    }
+
+    uint64_t m_words[kWords];
+    vector<uint64_t> m_more; // the words past kWords
+};
+
+// The monsters of the turn as a structure of arrays, padded to a multiple of kLanes so that
+// the kernels never need a scalar tail (the padding stands far out of every range).
+//
+// The kernels run on 32-bit lanes with AVX2 or SSE2 when the compiler targets them, and as
+// plain loops otherwise (or with BRAIN_NO_SIMD). The squared distances are exact as long as
+// |dx| and |dy| stay below 32768, which holds between any two points around the map.
+class MonsterTable {
+public:
+    static constexpr int kLanes = 8;
+    static constexpr int kMaxRange = 32767;
+    static constexpr int kFarAway = 1 << 20;
+    static constexpr int kMaxReaches = 4; // radii of masks()
+
+    MonsterTable() : m_size(0) {
+        for (auto * v : { &m_x, &m_y, &m_vx, &m_vy, &m_hp, &m_shield }) v->reserve(kMaxEntities);
+    }
+
+    void build(const vector<Monster> & monsters) {
+        m_size = monsters.size();
+        int n = padded();
+        for (auto * v : { &m_x, &m_y, &m_vx, &m_vy, &m_hp, &m_shield }) v->resize(n);
+        for (int i = 0; i < m_size; ++i) {
+            const auto & m = monsters[i];
+            m_x[i] = m.pos.x;
+            m_y[i] = m.pos.y;
+            m_vx[i] = m.v.x;
+            m_vy[i] = m.v.y;
+            m_hp[i] = m.hp;
+            m_shield[i] = m.shield;
+        }
+        for (int i = m_size; i < n; ++i) {
+            m_x[i] = m_y[i] = kFarAway;
+            m_vx[i] = m_vy[i] = m_hp[i] = m_shield[i] = 0;
+        }
+    }
+
+    int size() const { return m_size; }
+
+    // the length of the arrays (and of the outputs of the kernels)
+    int padded() const { return (m_size + kLanes - 1) / kLanes * kLanes; }
+
+    // the indices of the monsters within r of p, in ascending order
+    template <typename Out>
+    void within(const Point & p, int r, Out & out) const {
+        out.clear();
+        for (int i = 0; i < m_size; i += kLanes) {
+            for (unsigned mask = within_mask(p, r, i); mask != 0; mask &= mask - 1) {
+                out.push_back(i + __builtin_ctz(mask));
+            }
+        }
+    }
+
+    // the number of monsters within r of p (only the ones without a shield if asked)
+    int count_within(const Point & p, int r, bool unshielded = false) const {
+        int ans = 0;
+        for (int i = 0; i < m_size; i += kLanes) {
+            unsigned mask = within_mask(p, r, i);
+            if (unshielded) mask &= unshielded_mask(i);
+            ans += __builtin_popcount(mask);
+        }
+        return ans;
+    }
+
+    // the sets of the monsters within each of the n radii of p, in a single pass
+    void masks(const Point & p, const int * radii, int n, MonsterMask * out) const {
+        unsigned lanes[kMaxReaches];
+        for (int k = 0; k < n; ++k) out[k].clear();
+        for (int i = 0; i < m_size; i += kLanes) {
+            within_masks(p, radii, n, i, lanes);
+            for (int k = 0; k < n; ++k) out[k].set_lanes(i, lanes[k]);
+        }
+    }
+
+    // the set of the monsters without a shield
+    MonsterMask unshielded() const {
+        MonsterMask ans;
+        for (int i = 0; i < m_size; i += kLanes) ans.set_lanes(i, unshielded_mask(i));
+        return ans;
+    }
+
+    // the squared distances from p to every monster (out: padded() entries, the ones of the
+    // padding are meaningless)
+    void distances2(const Point & p, int * out) const {
+        int i = 0;
+#if defined(BRAIN_AVX2)
+        __m256i px = _mm256_set1_epi32(p.x);
+        __m256i py = _mm256_set1_epi32(p.y);
+        for (; i < padded(); i += 8) {
+            __m256i dx = _mm256_sub_epi32(load8(m_x, i), px);
+            __m256i dy = _mm256_sub_epi32(load8(m_y, i), py);
+            __m256i d2 = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+            _mm256_storeu_si256((__m256i *) (out + i), d2);
+        }
+#elif defined(BRAIN_SSE2)
+        __m128i px = _mm_set1_epi32(p.x);
+        __m128i py = _mm_set1_epi32(p.y);
+        for (; i < padded(); i += 4) {
+            __m128i dx = _mm_sub_epi32(load4(m_x, i), px);
+            __m128i dy = _mm_sub_epi32(load4(m_y, i), py);
+            _mm_storeu_si128((__m128i *) (out + i), squares_sum(dx, dy));
+        }
+#endif
+        for (; i < m_size; ++i) {
+            int dx = m_x[i] - p.x;
+            int dy = m_y[i] - p.y;
+            out[i] = dx * dx + dy * dy;
+        }
+    }
+
+    // the positions of every monster in k turns, on their straight lines (xs and ys: padded()
+    // entries); k and the speeds are below 32768
+    void step(int k, int * xs, int * ys) const {
+        int i = 0;
+#if defined(BRAIN_AVX2)
+        __m256i kk = _mm256_set1_epi32(k);
+        for (; i < padded(); i += 8) {
+            __m256i x = _mm256_add_epi32(load8(m_x, i), _mm256_mullo_epi32(kk, load8(m_vx, i)));
+            __m256i y = _mm256_add_epi32(load8(m_y, i), _mm256_mullo_epi32(kk, load8(m_vy, i)));
+            _mm256_storeu_si256((__m256i *) (xs + i), x);
+            _mm256_storeu_si256((__m256i *) (ys + i), y);
+        }
+#elif defined(BRAIN_SSE2)
+        // no 32-bit multiplication in SSE2: (low 16 bits, sign) * (k, 0) with madd
+        __m128i kk = _mm_set1_epi32(k & 0xffff);
+        for (; i < padded(); i += 4) {
+            __m128i x = _mm_add_epi32(load4(m_x, i), _mm_madd_epi16(load4(m_vx, i), kk));
+            __m128i y = _mm_add_epi32(load4(m_y, i), _mm_madd_epi16(load4(m_vy, i), kk));
+            _mm_storeu_si128((__m128i *) (xs + i), x);
+            _mm_storeu_si128((__m128i *) (ys + i), y);
+        }
+#endif
+        for (; i < padded(); ++i) {
+            xs[i] = m_x[i] + k * m_vx[i];
+            ys[i] = m_y[i] + k * m_vy[i];
+        }
+    }
+
+private:
+    // bit j: the monster i + j is within r of p (i: a multiple of kLanes)
+    unsigned within_mask(const Point & p, int r, int i) const {
+        unsigned mask;
+        within_masks(p, &r, 1, i, &mask);
+        return mask;
+    }
+
+    // the same for n radii at once: the squared distances are computed once
+    void within_masks(const Point & p, const int * radii, int n, int i, unsigned * masks) const {
+        int rmax = *std::max_element(radii, radii + n);
+        if (rmax > kMaxRange) {
+            for (int k = 0; k < n; ++k) masks[k] = within_mask_scalar(p, radii[k], i);
+            return;
+        }
+#if defined(BRAIN_AVX2)
+        // in the box first: the squares cannot overflow then
+        __m256i dx = _mm256_sub_epi32(load8(m_x, i), _mm256_set1_epi32(p.x));
+        __m256i dy = _mm256_sub_epi32(load8(m_y, i), _mm256_set1_epi32(p.y));
+        __m256i r1 = _mm256_set1_epi32(rmax + 1);
+        __m256i box = _mm256_and_si256(_mm256_cmpgt_epi32(r1, _mm256_abs_epi32(dx)),
+                                       _mm256_cmpgt_epi32(r1, _mm256_abs_epi32(dy)));
+        __m256i d2 = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+        for (int k = 0; k < n; ++k) {
+            __m256i in = _mm256_and_si256(box, _mm256_cmpgt_epi32(_mm256_set1_epi32(radii[k] * radii[k] + 1), d2));
+            masks[k] = _mm256_movemask_ps(_mm256_castsi256_ps(in));
+        }
+#elif defined(BRAIN_SSE2)
+        __m128i r1 = _mm_set1_epi32(rmax + 1);
+        __m128i nr1 = _mm_set1_epi32(-rmax - 1);
+        for (int k = 0; k < n; ++k) masks[k] = 0;
+        for (int j = 0; j < kLanes; j += 4) {
+            __m128i dx = _mm_sub_epi32(load4(m_x, i + j), _mm_set1_epi32(p.x));
+            __m128i dy = _mm_sub_epi32(load4(m_y, i + j), _mm_set1_epi32(p.y));
+            __m128i box = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(r1, dx), _mm_cmpgt_epi32(dx, nr1)),
+                                        _mm_and_si128(_mm_cmpgt_epi32(r1, dy), _mm_cmpgt_epi32(dy, nr1)));
+            __m128i d2 = squares_sum(dx, dy);
+            for (int k = 0; k < n; ++k) {
+                __m128i in = _mm_and_si128(box, _mm_cmplt_epi32(d2, _mm_set1_epi32(radii[k] * radii[k] + 1)));
+                masks[k] |= _mm_movemask_ps(_mm_castsi128_ps(in)) << j;
+            }
+        }
+#else
+        for (int k = 0; k < n; ++k) masks[k] = within_mask_scalar(p, radii[k], i);
+#endif
+    }
+
+    unsigned within_mask_scalar(const Point & p, int r, int i) const {
+        unsigned mask = 0;
+        for (int j = 0; j < kLanes; ++j) {
+            if (::within(Point(m_x[i + j], m_y[i + j]), p, r)) mask |= 1u << j;
+        }
+        return mask;
+    }
+
+    // bit j: the monster i + j has no shield
+    unsigned unshielded_mask(int i) const {
+        unsigned mask = 0;
+        for (int j = 0; j < kLanes; ++j) {
+            if (m_shield[i + j] == 0) mask |= 1u << j;
+        }
+        return mask;
+    }
+
+#if defined(BRAIN_AVX2)
+    static __m256i load8(const vector<int> & v, int i) {
+        return _mm256_loadu_si256((const __m256i *) (v.data() + i));
+    }
+#elif defined(BRAIN_SSE2)
+    static __m128i load4(const vector<int> & v, int i) {
+        return _mm_loadu_si128((const __m128i *) (v.data() + i));
+    }
+
+    // dx * dx + dy * dy, the pairs interleaved as 16 bits (saturated beyond 32767) for madd
+    static __m128i squares_sum(__m128i dx, __m128i dy) {
+        __m128i d = _mm_packs_epi32(dx, dy);
+        d = _mm_unpacklo_epi16(d, _mm_srli_si128(d, 8));
+        return _mm_madd_epi16(d, d);
+    }
+#endif
+
+    int m_size;
+    vector<int> m_x;
+    vector<int> m_y;
+    vector<int> m_vx;
+    vector<int> m_vy;
+    vector<int> m_hp;
+    vector<int> m_shield;
+};
+
+// Where the monsters of the turn will be in the next turns, under the rules of the referee:
+// a monster walks its straight line until it enters the radius of a base, then heads for
+// that base and hits it within kBaseAttackRange; a monster walking off the map is gone
+// (nothing bounces). The pass goes turn after turn over all the monsters, the positions of
+// one turn being contiguous: the straight lines come from MonsterTable::step(), and only the
+// monsters heading for a base (or gone) are moved one by one. Every query is then a lookup.
+// The heros are not modelled. A
+// deadline met while building cuts the horizon short (to one turn at least): what lies
+// beyond it is then unknown, as beyond kTurns.
+class MonsterForecast {
+public:
+    static constexpr int kTurns = 32; // the horizon
+    static constexpr int kNever = -1; // not within the horizon
+    static constexpr int kUnknown = -2; // eta(): the horizon is too short to tell
+
+    MonsterForecast() : m_size(0), m_stride(0), m_horizon(0) {
+        m_x.reserve((kTurns + 1) * kMaxEntities);
+        m_y.reserve((kTurns + 1) * kMaxEntities);
+        for (auto * v : { &m_end, &m_target, &m_inside[0], &m_inside[1], &m_hit[0], &m_hit[1] }) {
+            v->reserve(kMaxEntities);
+        }
+    }
+
+    // The bases are indexed as the threats of the monsters: 0 for ours, 1 for theirs. The
+    // table holds the same monsters, in the same order.
+    void build(const vector<Monster> & monsters, const MonsterTable & table, const Base & ours,
+               const Base & theirs, const Deadline & deadline = Deadline()) {
+        m_size = monsters.size();
+        m_stride = table.padded();
+        m_horizon = kTurns;
+        m_bases[0] = ours.pos;
+        m_bases[1] = theirs.pos;
+        m_x.resize((kTurns + 1) * m_stride);
+        m_y.resize((kTurns + 1) * m_stride);
+        for (auto * v : { &m_end, &m_target, &m_inside[0], &m_inside[1], &m_hit[0], &m_hit[1] }) {
+            v->assign(m_size, kNever);
+        }
+        table.step(0, m_x.data(), m_y.data());
+        for (int i = 0; i < m_size; ++i) {
+            const auto & m = monsters[i];
+            m_end[i] = m.pos.valid() ? kTurns + 1 : 0;
+            if (m.target != 0 && (m.threat == 1 || m.threat == 2)) m_target[i] = m.threat - 1;
+            for (int b = 0; b < 2; ++b) {
+                if (within(m.pos, m_bases[b], kRadiusOfBase)) m_inside[b][i] = 0;
+            }
+        }
+        for (int t = 1; t <= kTurns; ++t) {
+            // the clock is read every 8 turns, from the second one
+            if ((t & 7) == 2 && deadline.expired()) {
+                m_horizon = t - 1;
+                break;
+            }
+            const int * px = m_x.data() + (t - 1) * m_stride;
+            const int * py = m_y.data() + (t - 1) * m_stride;
+            int * x = m_x.data() + t * m_stride;
+            int * y = m_y.data() + t * m_stride;
+            // all on their straight lines, then the ones which left them
+            table.step(t, x, y);
+            for (int i = 0; i < m_size; ++i) {
+                if (t >= m_end[i]) {
+                    x[i] = px[i];
+                    y[i] = py[i];
+                } else if (m_target[i] >= 0) {
+                    Point p = head_for_base(Point(px[i], py[i]), i, t);
+                    x[i] = p.x;
+                    y[i] = p.y;
+                } else {
+                    walk(Point(x[i], y[i]), i, t);
+                }
+            }
+        }
+    }
+
+    int size() const { return m_size; }
+
+    // the position of the monster of this row in t turns (t in [0, kTurns]), the last one
+    // known once it is gone or past the horizon
+    Point at(int row, int t) const {
+        t = std::min(t, m_horizon);
+        return Point(m_x[t * m_stride + row], m_y[t * m_stride + row]);
+    }
+
+    bool alive(int row, int t) const { return t < m_end[row]; }
+
+    // the first turn in the radius of a base (0 if already there)
+    int inside(int row, int base) const { return m_inside[base][row]; }
+
+    // the turn it damages a base (it is gone afterwards)
+    int hit(int row, int base) const { return m_hit[base][row]; }
+
+    // The first turn k (from 1) a hero leaving p now hits the monster, kNever if not within the
+    // horizon. The heros move before they attack and the monsters after: the k-th hit is on the
+    // monster at(row, k - 1), which must be within speed * k + range of p. The hero being the
+    // faster, it stays so once it is, and k is found by bisection.
+    int intercept(int row, const Point & p, int speed, int range) const {
+        auto reached = [&](int k) { return within(p, at(row, k - 1), speed * k + range); };
+        int high = std::min(m_horizon, m_end[row]);
+        if (high < 1 || !reached(high)) return kNever;
+        int low = 1;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (reached(mid)) {
+                high = mid;
+            } else {
+                low = mid + 1;
+            }
+        }
+        return low;
+    }
+
+    // How many turns to reach to a base, as Monster::eta counts them: the turn it enters the
+    // radius plus the walk from there (-1 if it never comes)
+    int eta(int row, int base) const {
+        int k = m_inside[base][row];
+        if (k != kNever) {
+            int ans = k;
+            float dist = distance(at(row, k), m_bases[base]);
+            ans += dist / kMonsterSpeed;
+            return ans;
+        }
+        // it leaves the map, hits a base, or is taken by the other one
+        if (m_end[row] <= kTurns || m_target[row] >= 0) return -1;
+        return kUnknown;
+    }
+
+private:
+    // one turn of a monster heading for its base, alive at turn t - 1 (the move of the referee)
+    Point head_for_base(Point p, int i, int t) {
+        const Point & base = m_bases[m_target[i]];
+        if (distance(p, base) <= kMonsterSpeed) {
+            p = base;
+        } else {
+            p += scale_toward(p, base, kMonsterSpeed);
+        }
+        if (within(p, base, kBaseAttackRange)) {
+            m_hit[m_target[i]][i] = m_end[i] = t;
+        }
+        return p;
+    }
+
+    // a monster on its straight line, at p at turn t: it may leave the map or enter the radius
+    // of a base
+    void walk(const Point & p, int i, int t) {
+        if (!p.valid()) {
+            m_end[i] = t;
+            return;
+        }
+        for (int b = 0; b < 2; ++b) {
+            if (!within(p, m_bases[b], kRadiusOfBase)) continue;
+
+            m_target[i] = b;
+            m_inside[b][i] = t;
+            break;
+        }
+    }
+
+    int m_size;
+    int m_stride; // of a turn in m_x and m_y: MonsterTable::padded()
+    int m_horizon; // the turns forecast: kTurns unless the deadline cut the build
+    Point m_bases[2];
+    vector<int> m_x; // [turn * stride + row]
+    vector<int> m_y;
+    vector<int> m_end; // the first turn the monster no longer exists
+    vector<int> m_target; // the base it heads for (-1 for none)
+    vector<int> m_inside[2];
+    vector<int> m_hit[2];
+};
+
+// A min-heap of events by (turn, id), one entry per slot of the entity store at most, which
+// knows where each slot sits in it: an entry is moved or removed in O(log n)
+class EventHeap {
+public:
+    struct Event {
+        int turn;
+        int id;
+        int slot;
+    };
+
+    EventHeap() {
+        m_heap.reserve(kMaxEntities);
+        m_where.reserve(kMaxEntities);
+    }
+
+    bool empty() const { return m_heap.empty(); }
+    int size() const { return m_heap.size(); }
+    const Event & top() const { return m_heap.front(); }
+
+    bool contains(int slot) const {
+        return slot < (int) m_where.size() && m_where[slot] >= 0;
+    }
+
+    // insert the event of a slot, or move it
+    void set(int slot, int id, int turn) {
+        if (slot >= (int) m_where.size()) m_where.resize(slot + 1, -1);
+        int i = m_where[slot];
+        if (i < 0) {
+            i = m_heap.size();
+            m_heap.push_back(Event{ turn, id, slot });
+            m_where[slot] = i;
+        } else {
+            m_heap[i].turn = turn;
+            m_heap[i].id = id;
+        }
+        sift_down(sift_up(i));
+    }
+
+    void erase(int slot) {
+        if (!contains(slot)) return;
+        int i = m_where[slot];
+        m_where[slot] = -1;
+        int last = m_heap.size() - 1;
+        if (i != last) {
+            m_heap[i] = m_heap[last];
+            m_where[m_heap[i].slot] = i;
+        }
+        m_heap.pop_back();
+        if (i < (int) m_heap.size()) sift_down(sift_up(i));
+    }
+
+private:
+    static bool before(const Event & a, const Event & b) {
+        return a.turn < b.turn || (a.turn == b.turn && a.id < b.id);
+    }
+
+    void place(int i, const Event & e) {
+        m_heap[i] = e;
+        m_where[e.slot] = i;
+    }
+
+    int sift_up(int i) {
+        Event e = m_heap[i];
+        while (i > 0) {
+            int parent = (i - 1) / 2;
+            if (!before(e, m_heap[parent])) break;
+            place(i, m_heap[parent]);
+            i = parent;
+        }
+        place(i, e);
+        return i;
+    }
+
+    void sift_down(int i) {
+        Event e = m_heap[i];
+        int n = m_heap.size();
+        for (;;) {
+            int child = 2 * i + 1;
+            if (child >= n) break;
+            if (child + 1 < n && before(m_heap[child + 1], m_heap[child])) ++child;
+            if (!before(m_heap[child], e)) break;
+            place(i, m_heap[child]);
+            i = child;
+        }
+        place(i, e);
+    }
+
+    vector<Event> m_heap;
+    vector<int> m_where; // slot => index in m_heap (-1 if absent)
+};
+
+// The monsters near our base by the turn they are predicted to hit it, kept from one turn to
+// the next: a monster seen in the state the previous turn predicted keeps its turn, and only
+// the other ones (new, pushed, hit, controlled or shielded) are forecast again. The next one
+// to hit is the top of a heap: a monster entering or leaving the neighbourhood, or forecast
+// again, moves in O(log n); the others cost nothing.
+class ThreatTimeline {
+public:
+    ThreatTimeline() : m_turn(0) { m_expected.reserve(kMaxEntities); }
+
+    void begin_turn() { ++m_turn; }
+
+    // a turn not observed: the events stand, and every monster is forecast again next turn
+    void skip_turn() { ++m_turn; }
+
+    int turn() const { return m_turn; }
+
+    // a monster of this turn, at this row of the forecast, near our base or not
+    void observe_monster(int slot, const Monster & m, const MonsterForecast & forecast, int row, bool near) {
+        auto & x = expected(slot);
+        // the fate of the monster beyond the horizon is looked at again every turn
+        bool same = x.seen == m_turn - 1 && x.settled && x.id == m.id && x.pos == m.pos && x.v == m.v
+            && x.hp == m.hp && x.shield == m.shield;
+        if (!same) {
+            int hit = forecast.hit(row, 0);
+            x.hit = hit == MonsterForecast::kNever ? MonsterForecast::kNever : m_turn + hit;
+        }
+        if (!near || x.hit == MonsterForecast::kNever) {
+            m_events.erase(slot);
+        } else if (!same || !m_events.contains(slot)) {
+            m_events.set(slot, m.id, x.hit);
+        }
+        x.seen = m_turn;
+        x.id = m.id;
+        x.pos = forecast.alive(row, 1) ? forecast.at(row, 1) : Point(-1, -1);
+        x.settled = !forecast.alive(row, MonsterForecast::kTurns);
+        x.v = m.v;
+        x.hp = m.hp;
+        x.shield = std::max(m.shield - 1, 0);
+    }
+
+    // forget what is gone or past (an event of this turn has happened already)
+    void end_turn() {
+        for (int slot = 0; slot < (int) m_expected.size(); ++slot) {
+            if (m_expected[slot].seen == m_turn || m_expected[slot].seen < 0) continue;
+            m_events.erase(slot);
+            m_expected[slot].seen = -1;
+        }
+        while (!m_events.empty() && m_events.top().turn <= m_turn) m_events.erase(m_events.top().slot);
+    }
+
+    // the next monster near our base to hit it (its turn is absolute, see turn())
+    bool empty() const { return m_events.empty(); }
+    const EventHeap::Event & next() const { return m_events.top(); }
+
+private:
+    struct Expected {
+        int seen = -1; // the turn of the last observation
+        int id = -1;
+        Point pos; // where it should be at the next turn
+        Point v;
+        int hp = 0;
+        int shield = 0;
+        bool settled = false; // gone within the horizon
+        int hit = MonsterForecast::kNever; // the turn it hits our base
+    };
+
+    Expected & expected(int slot) {
+        if (slot >= (int) m_expected.size()) m_expected.resize(slot + 1);
+        return m_expected[slot];
+    }
+
+    int m_turn;
+    vector<Expected> m_expected; // by slot
+    EventHeap m_events; // of the monsters near our base
+};
+
+// The distinct targets of a few heros (or kIdle: nothing) minimising the sum of their costs.
+// The search is exhaustive over the kCandidates cheapest targets of every hero, which is exact
+// as long as there are not more heros than candidates (another hero can take at most one of
+// the cheaper ones), and bounded by (kCandidates + 1) ^ heros whatever the number of targets.
+// The kRanks cheapest assignments are kept, for a planner to try the runners-up.
+class AssignmentSolver {
 public:
-    Monster(Entity e): Entity(e) {}
+    static constexpr int kMaxHeros = kHerosPerPlayer;
+    static constexpr int kCandidates = 6;
+    static constexpr int kRanks = 4;
+    static constexpr int kIdle = -1;
+    static constexpr int kForbidden = std::numeric_limits<int>::max() / 4;
+
+    AssignmentSolver() : m_heros(0), m_targets(0), m_required(kIdle), m_found(0) {
+        m_cost.reserve(kMaxHeros * kMaxEntities);
+    }
 
-    void display(std::ostream & os) const {
-        os << "Monster " << id << ": ";
-        os << "hp=" << hp;
-        os << "; pos=" << pos;
-        os << "; v=" << v;
+    // every pair forbidden, and idle for free
+    void reset(int heros, int targets) {
+        m_heros = std::min(heros, kMaxHeros);
+        m_targets = targets;
+        m_required = kIdle;
+        m_cost.assign(m_heros * m_targets, kForbidden);
+        for (int h = 0; h < m_heros; ++h) m_idle[h] = 0;
     }
 
-    // How many turns to reach to the destination point
-    int eta(const Base & base) const {
-        auto dest = base.pos;
-        auto curr = pos;
-        int ans = 0;
-        while (curr.valid()) {
-            float dist = distance(dest, curr);
-            if (dist <= kRadiusOfBase) {
-                ans += dist / kMonsterSpeed;
-                break;
-            } else {
-                ++ans;
-                curr += v;
-            }
+    void set(int h, int t, int cost) { m_cost[h * m_targets + t] = cost; }
+    void set_idle(int h, int cost) { m_idle[h] = cost; }
+
+    // a target someone must take (if anyone can)
+    void require(int t) { m_required = t; }
+
+    // the target of every hero in out; the total cost (kForbidden if nothing is feasible, all
+    // the heros being idle then)
+    int solve(int * out) {
+        for (int h = 0; h < m_heros; ++h) select_candidates(h);
+        m_found = 0;
+        search(0, 0);
+        if (m_found == 0) {
+            std::fill(out, out + m_heros, (int) kIdle);
+            return kForbidden;
         }
-        return curr.valid() ? ans : -1;
+        return ranked(0, out);
+    }
+
+    // the number of feasible assignments kept by the last solve (at most kRanks)
+    int found() const { return m_found; }
+
+    // the rank-th cheapest of them (rank < found()) in out, and its cost
+    int ranked(int rank, int * out) const {
+        for (int h = 0; h < m_heros; ++h) out[h] = m_best[rank][h];
+        return m_bestCost[rank];
     }
 
 private:
-};
+    // the cheapest feasible targets of a hero, in ascending cost (plus the required one)
+    void select_candidates(int h) {
+        int n = 0;
+        for (int t = 0; t < m_targets; ++t) {
+            int c = m_cost[h * m_targets + t];
+            if (c >= kForbidden || t == m_required) continue;
+            if (n == kCandidates && c >= cost(h, m_candidates[h][n - 1])) continue;
+
+            int i = n < kCandidates ? n++ : n - 1;
+            for (; i > 0 && cost(h, m_candidates[h][i - 1]) > c; --i) {
+                m_candidates[h][i] = m_candidates[h][i - 1];
+            }
+            m_candidates[h][i] = t;
+        }
+        if (m_required != kIdle && cost(h, m_required) < kForbidden) m_candidates[h][n++] = m_required;
+        m_count[h] = n;
+    }
 
-std::ostream & operator<<(std::ostream & os, const Monster & m) {
-    m.display(os);
-    return os;
-}
+    int cost(int h, int t) const {
+        return t == kIdle ? m_idle[h] : m_cost[h * m_targets + t];
+    }
 
-// find the monsters in the range
-vector<Monster> discover_in_range(const vector<Monster> & monsters, Point pos, int range) {
-    vector<Monster> ans;
-    for (const auto & m : monsters) {
-        if (distance(m.pos, pos) <= range) {
-            ans.push_back(m);
+    // the costs may be negative: no pruning on partial sums
+    void search(int h, int sum) {
+        if (h == m_heros) {
+            if (m_found == kRanks && sum >= m_bestCost[kRanks - 1]) return;
+            if (m_required != kIdle && !taken(m_required, h) && required_feasible()) return;
+            // after the ones as cheap: the first found stays first
+            int i = m_found < kRanks ? m_found++ : kRanks - 1;
+            for (; i > 0 && m_bestCost[i - 1] > sum; --i) {
+                m_bestCost[i] = m_bestCost[i - 1];
+                std::copy(m_best[i - 1], m_best[i - 1] + m_heros, m_best[i]);
+            }
+            m_bestCost[i] = sum;
+            std::copy(m_current, m_current + m_heros, m_best[i]);
+            return;
+        }
+        for (int i = 0; i < m_count[h]; ++i) {
+            int t = m_candidates[h][i];
+            if (taken(t, h)) continue;
+            m_current[h] = t;
+            search(h + 1, sum + cost(h, t));
+        }
+        if (m_idle[h] < kForbidden) {
+            m_current[h] = kIdle;
+            search(h + 1, sum + m_idle[h]);
         }
     }
-    return ans;
-}
+
+    // whether one of the first heros has this target
+    bool taken(int t, int heros) const {
+        for (int h = 0; h < heros; ++h) {
+            if (m_current[h] == t) return true;
+        }
+        return false;
+    }
+
+    bool required_feasible() const {
+        for (int h = 0; h < m_heros; ++h) {
+            if (cost(h, m_required) < kForbidden) return true;
+        }
+        return false;
+    }
+
+    int m_heros;
+    int m_targets;
+    int m_required;
+    vector<int> m_cost; // [hero * targets + target]
+    int m_idle[kMaxHeros];
+    int m_candidates[kMaxHeros][kCandidates + 1];
+    int m_count[kMaxHeros];
+    int m_current[kMaxHeros];
+    int m_best[kRanks][kMaxHeros];
+    int m_bestCost[kRanks];
+    int m_found;
+};
 
 int find_max_hp(const vector<Monster> & monsters) {
     int ans = 0;
@@ -414,10 +2420,9 @@ int other_defencer(int idx) {
     return kNumberOfDefenders - 1 - idx;
 }
 
-// eval the risk of this monster based on its eta to the base
-int eval_risk(const Base & ref, const Monster & m) {
+// eval the risk of this monster given its eta to the base
+int eval_risk(const Monster & m, int eta) {
     int ans = 0;
-    int eta = m.eta(ref);
 
     if (m.target != 0) {
         // this unit is directing to our base
@@ -433,74 +2438,90 @@ int eval_risk(const Base & ref, const Monster & m) {
     return ans > 0 ? ans : 0;
 }
 
-Point compute_cartesian_point(const Base & base, int r, int angle) {
-    bool mirrow = base.pos.x == 0 ? false : true;
+// eval the risk of this monster based on its eta to the base
+int eval_risk(const Base & ref, const Monster & m) {
+    return eval_risk(m, m.eta(ref));
+}
+
+// What is known about a monster for the current turn (computed once per turn)
+struct MonsterFeatures {
+    int eta[2]; // to our base, to their base
+    int risk[2]; // eval_risk() against our base, against their base
+    int nearestHero; // the index of our nearest hero
+    int nearestDefender; // the same among the defenders
+    int row; // in m_monsters (and in the monster table)
+};
 
-    if (mirrow) angle += 180;
+// the angles are measured from the edges of the map next to the base (so the ones around
+// their base look the other way)
+Point compute_cartesian_point(const Base & base, int r, int angle) {
+    if (base.pos.x != kOurCorner.x) angle += 180;
     RadialPoint rp(base.pos, r, angle);
     return convert_polar_to_cartesian(rp);
 }
 
 class Hero : public Entity {
 public:
-    Hero(Entity e): Entity(e), m_cmd(""), m_spellingWind(false)
+    // the points of the commands are given in the canonical frame
+    Hero(Entity e, Frame frame = Frame()): Entity(e), m_frame(frame), m_order(), m_cmd(), m_spellingWind(false)
     {
     }
 
     void move(const Point & p) {
         undo();
-        m_cmd << "MOVE " << p.x << " " << p.y;
+        Point q = m_frame.point(p);
+        m_order = Order(MOVE, 0, q);
+        m_cmd << "MOVE " << q.x << " " << q.y;
     }
 
-    void move(const Point & p, int r, int angle, bool mirrow = false) {
-        if (mirrow) angle += 180;
-
+    void move(const Point & p, int r, int angle) {
         RadialPoint rp(p, r, angle);
         move(convert_polar_to_cartesian(rp));
     }
 
     void move(const Base & base, int r, int angle) {
-        bool mirrow = base.pos.x == 0 ? false : true;
-        move(base.pos, r, angle, mirrow);
+        move(compute_cartesian_point(base, r, angle));
     }
 
-    void say(string words) {
+    void say(const string & words) {
         m_cmd << " " << words;
     }
 
     void wait() {
         undo();
+        m_order = Order();
         m_cmd << "WAIT Ndorē";
     }
 
     // enter a dummy action (a placeholder) which can be overriden
     void end() {
         undo();
+        m_order = Order();
         m_cmd << "WAIT End";
     }
 
     void wind(const Point & toward) {
         undo();
         m_spellingWind = true;
-        m_cmd << "SPELL WIND " << toward.x << " " << toward.y << " Súrë";
+        Point q = m_frame.point(toward);
+        m_order = Order(WIND, 0, q);
+        m_cmd << "SPELL WIND " << q.x << " " << q.y << " Súrë";
     }
 
     bool isWinding() const { return m_spellingWind; }
 
     void protect(int id) {
         undo();
+        m_order = Order(PROTECT, id, Point());
         m_cmd << "SPELL SHIELD " << id << " May force be with you";
     }
 
     void control(int id, const Point & toward) {
         undo();
         // elvish: this place
-        m_cmd << "SPELL CONTROL " << id << " " << toward.x << " " << toward.y << " sinomë";
-    }
-
-    // find the monsters in the range
-    vector<Monster> discover(const vector<Monster> & monsters) const {
-        return discover_in_range(monsters, pos, kHeroViewRange);
+        Point q = m_frame.point(toward);
+        m_order = Order(CONTROL, id, q);
+        m_cmd << "SPELL CONTROL " << id << " " << q.x << " " << q.y << " sinomë";
     }
 
     // find the heros in the range
@@ -508,22 +2529,20 @@ public:
         return discover_in_range(heros, pos, kHeroViewRange);
     }
 
-    vector<Monster> estimateWindAttackVictims(const vector<Monster> & monsters) const {
-        auto objects = discover_in_range(monsters, pos, kRadiusOfWind);
-        vector<Monster> ans;
-        for (const auto & o : objects) {
-            if (o.shield == 0) ans.push_back(o);
-        }
-        return ans;
-    }
+    bool orderReceived() const { return !m_cmd.empty(); }
 
-    bool orderReceived() const { return !m_cmd.str().empty(); }
+    // no order any more (the turn is planned again)
+    void cancel() {
+        undo();
+        m_order = Order();
+    }
 
-    void confirmOrder() {
+    void confirmOrder(Order & order, CommandLine & line) {
         if (!orderReceived()) {
             wait();
         }
-        cout << m_cmd.str() << endl;
+        order = m_order;
+        line = m_cmd;
     }
 
     void display(std::ostream & os) const {
@@ -535,11 +2554,13 @@ public:
 
 private:
     void undo() {
-        m_cmd.str("");
+        m_cmd.clear();
         m_spellingWind = false;
     }
 
-    std::stringstream m_cmd;
+    Frame m_frame;
+    Order m_order;
+    CommandLine m_cmd;
     bool m_spellingWind;
 };
 
@@ -552,45 +2573,15 @@ std::ostream& operator<<(std::ostream & os, const Hero & hero) {
 vector<int> discover_in_range(const vector<Hero> & heros, Point pos, int range) {
     vector<int> ans;
     for (const auto & h : heros) {
-        if (distance(h.pos, pos) <= range) {
+        if (within(h.pos, pos, range)) {
             ans.push_back(h.id);
         }
     }
     return ans;
 }
 
-// produce the index of this hero
-int find_nearest_hero(const Monster & monster, const vector<Hero> & heros) {
-    int ans;
-    int min_dist = kVeryBigDistance;
-    for (int i = 0; i < heros.size(); ++i) {
-        auto & hero = heros[i];
-        int dist = distance(hero.pos, monster.pos);
-        if (dist < min_dist) {
-            min_dist = dist;
-            ans = i;
-        }
-    }
-    return ans;
-}
-
-// produce the index of this defender
-int find_nearest_defender(const Monster & monster, const vector<Hero> & heros) {
-    int ans;
-    int min_dist = kVeryBigDistance;
-    for (int i = 0; i < kNumberOfDefenders; ++i) {
-        auto & hero = heros[i];
-        int dist = distance(hero.pos, monster.pos);
-        if (dist < min_dist) {
-            min_dist = dist;
-            ans = i;
-        }
-    }
-    return ans;
-}
-
-void cruise_between_angles(Hero & hero, const Base & ref, int radius, int low, int high) {
-    static bool goHighPos = false;
+// goHighPos: the way the hero is going (kept from one turn to the next by the caller)
+void cruise_between_angles(Hero & hero, const Base & ref, int radius, int low, int high, bool & goHighPos) {
     auto deg = calc_degree_between(ref.pos, hero.pos);
     if (deg < low + 1) {
         goHighPos = true;
@@ -604,18 +2595,54 @@ void cruise_between_angles(Hero & hero, const Base & ref, int radius, int low, i
     }
 }
 
+/*****************************************************************************
+ * In-process API of Brain: init() once per game, then step() once per turn
+ ****************************************************************************/
+// What a player sees at the beginning of a turn (in the real map)
+struct TurnInput {
+    Base ours; // hp and mp (the positions are given to Brain::init())
+    Base theirs;
+    vector<Entity> units;
+};
+
+// The commands of a turn, one per hero in the order of their ids
+struct TurnOutput {
+    int count;
+    Order orders[kHerosPerPlayer];
+    CommandLine lines[kHerosPerPlayer]; // the text expected by the referee
+
+    TurnOutput() : count(0) {}
+};
+
+// The thresholds of the strategy, so that their variants can play against each other
+// (tournament.cc)
+struct BrainParams {
+    int endingMaxHp; // a monster this strong ends the middle game
+    int middleMaxHp; // a monster this strong starts the middle game...
+    int middleMana; // ...provided we have this much mana
+    int shieldEta; // the attacker shields a monster this close to their base (in turns)
+
+    BrainParams() : endingMaxHp(24), middleMaxHp(17), middleMana(200), shieldEta(13) {}
+};
+
 class Brain {
 public:
+    Brain() : Brain(Base(), Base()) {}
+
     Brain(const Base & ours, const Base & theirs) :
-        m_ourBase(ours), m_theirBase(theirs), m_turns(0), m_allIn(false), m_madness(0), m_queue()
+        m_frame(Frame::of(ours.pos)), m_ourBase(ours), m_theirBase(theirs), m_turns(0), m_allIn(false), m_madness(0),
+        m_attackerStep(0), m_goHighPos(false), m_queue(), m_log(&cerr), m_timeBudget(0), m_passes(0),
+        m_rank(0), m_ranked(false)
     {
         m_phase = StartingGame;
-        // the blue team
-        m_blue = m_ourBase.pos.x == 0 ? true : false;
-        m_startPos = m_blue ? Point(2200, 6800) : Point(kWidth - 2200, kHeight - 6800);
-        m_endPos = m_blue ? Point(11130, 6800) : Point(kWidth - 11130, kHeight - 6800);
-        //m_attackPos = m_blue ? Point(11130, 6800) : Point(kWidth - 11130, kHeight - 6800);
-        m_attackPos = m_blue ? Point(12549, 6800) : Point(kWidth - 12549, kHeight - 6800);
+        std::fill(m_hasCircle, m_hasCircle + kNumberOfDefenders, false);
+        // everything is seen from the blue side
+        m_ourBase.pos = kOurCorner;
+        m_theirBase.pos = kTheirCorner;
+        m_startPos = Point(2200, 6800);
+        m_endPos = Point(11130, 6800);
+        //m_attackPos = Point(11130, 6800);
+        m_attackPos = Point(12549, 6800);
 
         // three default positions
         Point p = compute_cartesian_point(m_ourBase, kMidCircle, 30);
@@ -624,8 +2651,71 @@ public:
         m_defaultPos.push_back(p);
         p = Point(kWidth / 2, kHeight / 2);
         m_defaultPos.push_back(p);
+
+        // never reallocated afterwards
+        m_heros.reserve(kMaxEntities);
+        m_monsters.reserve(kMaxEntities);
+        m_opponents.reserve(kMaxEntities);
+        m_enemies.reserve(kMaxEntities);
+        m_neutral.reserve(kMaxEntities);
+        m_allies.reserve(kMaxEntities);
+        m_features.reserve(kMaxEntities);
+        m_intercepts.reserve(kHerosPerPlayer * kMaxEntities);
+    }
+
+    // a new game, our base being at this corner of the real map
+    void init(const Point & base) {
+        std::ostream * log = m_log;
+        BrainParams params = m_params;
+        int timeBudget = m_timeBudget;
+        Base ours, theirs;
+        ours.pos = base;
+        theirs.pos = Point(kWidth - base.x, kHeight - base.y);
+        *this = Brain(ours, theirs);
+        m_log = log;
+        m_params = params;
+        m_timeBudget = timeBudget;
+    }
+
+    // the commands for this turn (valid until the next call), the input having just been read
+    const TurnOutput & step(const TurnInput & in) {
+        read(in);
+        return decide();
+    }
+
+    // step() in two, for a look at the state of the turn before it is played: the input (the
+    // deadline starts here)...
+    void read(const TurnInput & in) {
+        m_deadline.start(m_timeBudget);
+        updateOurBase(in.ours.hp, in.ours.mp);
+        updateTheirBase(in.theirs.hp, in.theirs.mp);
+        parse(in.units);
+    }
+
+    // ...then the commands
+    const TurnOutput & decide() {
+        play();
+        return m_output;
+    }
+
+    // where the debug output goes (nullptr for nowhere)
+    void set_log(std::ostream * os) {
+        m_log = os;
+    }
+
+    void set_params(const BrainParams & params) {
+        m_params = params;
+    }
+
+    // the time of the decisions of a turn, from the call to step(), in us (0: no limit, the
+    // decisions then only depend on the input)
+    void set_time_budget(int micros) {
+        m_timeBudget = micros;
     }
 
+    // the plans made in the last turn (0 if the fallback was sent)
+    int passes() const { return m_passes; }
+
     void updateOurBase(int hp, int mp) {
         m_ourBase.update(hp, mp);
     }
@@ -639,42 +2729,76 @@ public:
         EndingGame
     };
 
-    void parse(const vector<Entity> & units) {
-        vector<Hero> heros;
-        vector<Monster> monsters;
-        vector<Hero> opponents;
+    // the first hit of a hero on a monster
+    struct Intercept {
+        int turn; // from 1 (MonsterForecast::kNever if not within the horizon)
+        Point point; // where the monster is then: where to go
+    };
 
-        for (const auto & e : units) {
+    // what a hero can reach: the monsters it can hit, push with a wind, or see
+    enum Reach {
+        ReachAttack,
+        ReachWind,
+        ReachView,
+        kReaches
+    };
+    static constexpr int kReachRadius[kReaches] = { kHeroPhysicAttackRange, kRadiusOfWind, kHeroViewRange };
+
+    void parse(const vector<Entity> & units) {
+        PROFILE_TURN_BEGIN();
+        PROFILE_SCOPE(StageParse);
+        // the temporaries of the previous turn are all dead
+        m_arena.reset();
+        m_heros.clear();
+        m_monsters.clear();
+        m_opponents.clear();
+
+        m_world.begin_turn();
+        for (const auto & unit : units) {
+            auto e = m_frame.entity(unit);
             // index the world
-            m_world[e.id] = e;
+            m_world.put(e);
             switch (e.type) {
                 case 0:
-                    monsters.push_back(e);
+                    m_monsters.push_back(e);
                     break;
 
                 case 1:
-                    heros.push_back(e);
+                    if (m_heros.size() < kHerosPerPlayer) m_heros.emplace_back(e, m_frame);
                     break;
 
                 case 2:
-                    opponents.push_back(e);
+                    if (m_opponents.size() < kHerosPerPlayer) m_opponents.emplace_back(e, m_frame);
                     break;
 
                 default:
                     throw("unknown type");
             }
         }
-        swap(m_heros, heros);
-        swap(m_monsters, monsters);
-        swap(m_opponents, opponents);
+        m_world.evict(kForgetAfter);
+        if (m_monsters.size() > kMaxMonsters) {
+            // the others are as good as unseen
+            log() << "Warning: " << m_monsters.size() << " monsters; the " << kMaxMonsters
+                  << " nearest to our base kept." << endl;
+            auto nearer = [&](const Monster & a, const Monster & b) {
+                return distance2(a.pos, m_ourBase.pos) < distance2(b.pos, m_ourBase.pos);
+            };
+            std::nth_element(m_monsters.begin(), m_monsters.begin() + kMaxMonsters, m_monsters.end(), nearer);
+            m_monsters.erase(m_monsters.begin() + kMaxMonsters, m_monsters.end());
+        }
+        m_table.build(m_monsters);
+        // past the deadline, only what the fallback needs, as cheaply as it can be had
+        m_forecast.build(m_monsters, m_table, m_ourBase, m_theirBase, m_deadline);
+        compute_features();
+        compute_intercepts();
+        update_timeline();
         classification(m_monsters);
     }
 
     bool is_opponent_all_in() {
         if (m_opponents.size() == kHerosPerPlayer) {
             for (const auto & op : m_opponents) {
-                int dist = distance(op.pos, m_ourBase.pos);
-                if (dist > kOutterCircle) {
+                if (!within(op.pos, m_ourBase.pos, kOutterCircle)) {
                     return false;
                 }
             }
@@ -691,39 +2815,232 @@ public:
         }
 
         int maxHp = find_max_hp(m_enemies);
-        if (maxHp >= 24 && m_phase == MiddleGame) {
+        if (maxHp >= m_params.endingMaxHp && m_phase == MiddleGame) {
             m_phase = EndingGame;
-        } else if (maxHp >= 17 && m_ourBase.mp >= 200) {
+        } else if (maxHp >= m_params.middleMaxHp && m_ourBase.mp >= m_params.middleMana) {
             m_phase = MiddleGame;
         } else if (m_allIn) {
             m_phase = MiddleGame;
         }
 
+        // an answer first, whatever the time left
+        plan_fallback();
+
         // planning phase
         //idle();
-        strategy_one_attacker();
+        plan();
+        PROFILE_TURN_END();
+    }
+
+    // Commands for all the heros without any search, in O(heros * monsters): the defenders go
+    // where they first hit the two most dangerous monsters (or back to their posts), the
+    // attacker where it first hits the nearest monster it sees (or it stays). They are what is
+    // sent if no time is left for the plan.
+    void plan_fallback() {
+        PROFILE_SCOPE(StageFallback);
+        m_output.count = std::min((int) m_heros.size(), kHerosPerPlayer);
+        for (int h = 0; h < m_output.count; ++h) {
+            // a copy: the commanders start from heros without orders
+            Hero hero = m_heros[h];
+            hero.move(fallback_destination(h));
+            hero.confirmOrder(m_output.orders[h], m_output.lines[h]);
+        }
+    }
+
+    Point fallback_destination(int h) const {
+        if (h < kNumberOfDefenders) {
+            // by decreasing risk
+            if (m_enemies.empty()) return m_defaultPos[h];
+            return intercept(h, m_enemies[std::min<int>(h, m_enemies.size() - 1)]).point;
+        }
+        const auto & hero = m_heros[h];
+        const Monster * nearest = nullptr;
+        for (int i : discover(hero.pos, kHeroViewRange)) {
+            const auto & m = m_monsters[i];
+            if (!nearest || distance2(m.pos, hero.pos) < distance2(nearest->pos, hero.pos)) nearest = &m;
+        }
+        return nearest ? intercept(h, *nearest).point : hero.pos;
+    }
+
+    // what the commanders change while they plan a turn
+    struct PlanState {
+        int mp;
+        int madness;
+        int attackerStep;
+        bool goHighPos;
+        Point defaultPos[kHerosPerPlayer];
+    };
+
+    PlanState plan_state() const {
+        PlanState state;
+        state.mp = m_ourBase.mp;
+        state.madness = m_madness;
+        state.attackerStep = m_attackerStep;
+        state.goHighPos = m_goHighPos;
+        std::copy(m_defaultPos.begin(), m_defaultPos.end(), state.defaultPos);
+        return state;
+    }
+
+    // the heros lose their orders too
+    void restore(const PlanState & state) {
+        m_ourBase.mp = state.mp;
+        m_madness = state.madness;
+        m_attackerStep = state.attackerStep;
+        m_goHighPos = state.goHighPos;
+        std::copy(state.defaultPos, state.defaultPos + m_defaultPos.size(), m_defaultPos.begin());
+        m_queue.clear();
+        for (auto & hero : m_heros) hero.cancel();
+    }
+
+    // The commanders improve on the fallback while time is left, every pass being planned
+    // again from the state of the turn, its searches stopping at the deadline with their best
+    // so far: the first pass is the plan of the strategy, the next ones take the runners-up of
+    // the assignments of the defenders (up to AssignmentSolver::kRanks), and a pass whose cover
+    // search ran out of sets is run again with twice the budget. A plan replaces the one sent
+    // only if done in time, and only if evaluate() has the one sent losing the game within
+    // kLookahead turns (as many monsters hitting our base as it has lives left) and not this
+    // one: the strategy knows better than the lookahead, which only sees the defenders, so the
+    // runners-up are only tried for a plan which loses. Without a deadline, every pass but the
+    // retries is made.
+    //
+    // The time of a pass is bounded by the caps, whatever the input: kMaxMonsters monsters and
+    // kHerosPerPlayer heros per side for the parse (the table and the forecast in
+    // O(kTurns * monsters), the intercepts in O(heros * monsters * log kTurns), the timeline in
+    // O(monsters * log monsters)) and for the fallback (O(heros * monsters)); the cover searches
+    // over at most JointCoverOptimiser::kMaxPoints points, within their budgets; the
+    // assignments over kCandidates targets per hero; the lookahead in
+    // O(kLookahead * defenders * monsters). Past the deadline, the forecast stops short and
+    // the intercepts, the timeline and the assignments are skipped.
+    void plan() {
+        m_passes = 0;
+        if (m_deadline.expired()) {
+            log() << "Warning: no time left to plan; fallback sent." << endl;
+            return;
+        }
+        const auto before = plan_state();
+        auto kept = before;
+        TurnOutput best = m_output;
+        int bestHits = 0;
+        int budget = JointCoverOptimiser::kBudget;
+        m_rank = 0;
+        while (true) {
+            m_ranked = false;
+            m_optimiser.limit(m_deadline);
+            m_cover.limit(budget, m_deadline);
+            strategy_one_attacker();
+            // too late (the best plan so far stands), or no runner-up left
+            if (m_deadline.expired() || (m_rank > 0 && !m_ranked)) break;
+            commit_my_commands();
+            int hits = evaluate();
+            // whether this plan saves a game the kept one loses
+            if (m_passes++ == 0 || (bestHits >= m_ourBase.hp && hits < m_ourBase.hp)) {
+                best = m_output;
+                bestHits = hits;
+                kept = plan_state();
+            }
+
+            bool cut = m_optimiser.cuts() + m_cover.cuts() > 0;
+            if (cut && m_deadline.set() && budget < kMaxCoverBudget) {
+                budget *= 2;
+            } else if (bestHits >= m_ourBase.hp && ++m_rank < AssignmentSolver::kRanks) {
+                budget = JointCoverOptimiser::kBudget;
+            } else {
+                break;
+            }
+            restore(before);
+        }
+        m_rank = 0;
+        m_output = best;
+        restore(kept);
+    }
+
+    // The monsters which hit our base within kLookahead turns of the forecast if the defenders
+    // follow the orders in m_output: they go to their destinations, then after the nearest
+    // monster left near our base, each of their hits dealing its damage to the monsters in
+    // range. The monsters sent away this turn are out of it, and the ones pushed by a wind
+    // walk their forecast again from where they were as many turns back as the push takes to
+    // walk; the other heros are not modelled. O(kLookahead * defenders * monsters).
+    int evaluate() const {
+        PROFILE_SCOPE(StageLookahead);
+        int n = m_monsters.size();
+        auto hp = scratch<int>();
+        auto delay = scratch<int>(); // turns set back by a wind
+        hp.reserve(n);
+        delay.reserve(n);
+        for (const auto & m : m_monsters) {
+            hp.push_back(m.hp);
+            delay.push_back(0);
+        }
+        // where a monster is when the heros hit on turn t
+        auto at = [&](int i, int t) { return m_forecast.at(i, std::max(0, t - 1 - delay[i])); };
+        auto alive = [&](int i, int t) { return hp[i] > 0 && m_forecast.alive(i, std::max(0, t - 1 - delay[i])); };
+
+        int defenders = std::min<int>(m_heros.size(), kNumberOfDefenders);
+        Point pos[kNumberOfDefenders];
+        Point dest[kNumberOfDefenders];
+        for (int h = 0; h < defenders; ++h) {
+            const auto & order = m_output.orders[h];
+            pos[h] = m_heros[h].pos;
+            dest[h] = order.verb == MOVE ? m_frame.point(order.dest) : pos[h];
+            if (order.verb == WIND) {
+                for (int i = 0; i < n; ++i) {
+                    const auto & m = m_monsters[i];
+                    if (m.shield > 0 || !within(m.pos, pos[h], kRadiusOfWind)) continue;
+                    delay[i] = (kWindPush + kMonsterSpeed - 1) / kMonsterSpeed;
+                }
+            } else if (order.verb == CONTROL) {
+                for (int i = 0; i < n; ++i) {
+                    if (m_monsters[i].id == order.object) hp[i] = 0;
+                }
+            }
+        }
 
-        // commit phase
-        commit_my_commands();
+        int hits = 0;
+        for (int t = 1; t <= kLookahead; ++t) {
+            for (int h = 0; h < defenders; ++h) {
+                if (t > 1 && pos[h] == dest[h]) {
+                    long long nearest = -1;
+                    for (int i = 0; i < n; ++i) {
+                        Point p = at(i, t);
+                        if (!alive(i, t)) continue;
+                        if (!within(p, m_ourBase.pos, kOutterCircle)) continue;
+                        if (nearest < 0 || distance2(p, pos[h]) < nearest) {
+                            nearest = distance2(p, pos[h]);
+                            dest[h] = p;
+                        }
+                    }
+                }
+                pos[h] = within(pos[h], dest[h], kHeroSpeed) ? dest[h] : pos[h] + scale_toward(pos[h], dest[h], kHeroSpeed);
+                for (int i = 0; i < n; ++i) {
+                    if (alive(i, t) && within(pos[h], at(i, t), kHeroPhysicAttackRange)) hp[i] -= kHeroPhysicAttackDmg;
+                }
+            }
+            for (int i = 0; i < n; ++i) {
+                int hit = m_forecast.hit(i, 0);
+                if (hit >= 0 && hp[i] > 0 && hit + delay[i] == t) ++hits;
+            }
+        }
+        return hits;
     }
 
     void commit_my_commands() {
+        PROFILE_SCOPE(StageCommit);
         if (m_queue.size() > 2) {
-            cerr << "Warning: more than 2 commands for the defenders." << endl;
+            log() << "Warning: more than 2 commands for the defenders." << endl;
         }
 
-        vector<bool> seen = { false, false };
+        bool seen[kNumberOfDefenders] = { false, false };
         while (!m_queue.empty()) {
             auto a = m_queue.front();
             m_queue.pop();
             int idx = a.subject;
             if (seen[idx]) {
-                cerr << "Warning: discard one command for Hero " << m_heros[idx].id << endl;
-                cerr << "Raw " << a << endl;
+                log() << "Warning: discard one command for Hero " << m_heros[idx].id << endl;
+                log() << "Raw " << a << endl;
                 continue;
             } else {
                 seen[idx] = true;
-                cerr << "Debug: " << a << endl;
+                log() << "Debug: " << a << endl;
             }
 
             auto & hero = m_heros[idx];
@@ -752,11 +3069,18 @@ public:
             if (!a.msg.empty()) hero.say(a.msg);
         }
 
-        for (auto & h : m_heros) {
-            h.confirmOrder();
+        m_output.count = std::min((int) m_heros.size(), kHerosPerPlayer);
+        for (int i = 0; i < m_output.count; ++i) {
+            m_heros[i].confirmOrder(m_output.orders[i], m_output.lines[i]);
         }
     }
 
+    // a stream without a buffer drops everything, and does not even format it
+    std::ostream & log() const {
+        thread_local std::ostream muted(nullptr);
+        return m_log ? *m_log : muted;
+    }
+
     // for debug purpose
     void showGameInfo() const {
         showStage();
@@ -767,69 +3091,75 @@ public:
 
 private:
     void showBases() const {
-        cerr << "our base: " << m_ourBase << endl;
-        cerr << "their base: " << m_theirBase << endl;
+        log() << "our base: " << m_ourBase << endl;
+        log() << "their base: " << m_theirBase << endl;
     }
 
     void showStage() const {
         switch (m_phase) {
             case StartingGame:
-                cerr << "=== stage: Starting (" << m_turns << ") ===" << endl;
+                log() << "=== stage: Starting (" << m_turns << ") ===" << endl;
                 break;
             case MiddleGame:
-                cerr << "=== stage: Middle (" << m_turns << ") ===" << endl;
+                log() << "=== stage: Middle (" << m_turns << ") ===" << endl;
                 break;
             case EndingGame:
-                cerr << "=== stage: EndingGame (" << m_turns << ") ===" << endl;
+                log() << "=== stage: EndingGame (" << m_turns << ") ===" << endl;
                 break;
 
             default:
-                cerr << "=== stage: Unknown (" << m_turns << ") ===" << endl;
+                log() << "=== stage: Unknown (" << m_turns << ") ===" << endl;
                 break;
         }
     }
 
     void showMonsters() const {
         // highest risk to our base
-        cerr << "=== our enemies (" << m_enemies.size() << ") ===" << endl;
+        log() << "=== our enemies (" << m_enemies.size() << ") ===" << endl;
         for (int i = 0; i < kHerosPerPlayer && i < m_enemies.size(); ++i) {
             const auto & m = m_enemies[i];
-            cerr << m << "; ETA=" << m.eta(m_ourBase) << endl;
+            log() << m << "; ETA=" << our_eta(m) << endl;
         }
         // neutral
-        cerr << "=== passengers (" << m_neutral.size() << ") ===" << endl;
+        log() << "=== passengers (" << m_neutral.size() << ") ===" << endl;
         for (int i = 0; i < kHerosPerPlayer && i < m_neutral.size(); ++i) {
             const auto & m = m_neutral[i];
-            cerr << m << "; ETA=" << m.eta(m_theirBase) << endl;
+            log() << m << "; ETA=" << their_eta(m) << endl;
         }
-        cerr << "=== our allies (" << m_allies.size() << ") ===" << endl;
+        log() << "=== our allies (" << m_allies.size() << ") ===" << endl;
         // highest risk to their base
         for (int i = 0; i < kHerosPerPlayer && i < m_allies.size(); ++i) {
             const auto & m = m_allies[i];
-            cerr << m << "; ETA=" << m.eta(m_theirBase) << endl;
+            log() << m << "; ETA=" << their_eta(m) << endl;
         }
     }
 
     void showHeros() const {
-        cerr << "=== our heros (" << m_heros.size() << ") ===" << endl;
+        log() << "=== our heros (" << m_heros.size() << ") ===" << endl;
         for (const auto & hero : m_heros) {
-            cerr << hero << endl;
+            log() << hero << endl;
         }
-        cerr << "=== their heros (" << m_opponents.size() << ") ===" << endl;
+        log() << "=== their heros (" << m_opponents.size() << ") ===" << endl;
         for (const auto & hero : m_opponents) {
-            cerr << hero << endl;
+            log() << hero << endl;
         }
     }
 
     void classification(const vector<Monster> & monsters) {
-        vector<Monster> enemies;
-        vector<Monster> allies;
-        vector<Monster> neutral;
+        PROFILE_SCOPE(StageClassification);
+        auto & enemies = m_enemies;
+        auto & allies = m_allies;
+        auto & neutral = m_neutral;
+        enemies.clear();
+        allies.clear();
+        neutral.clear();
+        m_enemyMask.clear();
         for (const auto & m : monsters) {
-            if (m.eta(m_ourBase) >= 0) {
+            if (our_eta(m) >= 0) {
                 // they can reach to our base
                 enemies.push_back(m);
-            } else if (m.eta(m_theirBase) >= 0) {
+                m_enemyMask.set(row(m));
+            } else if (their_eta(m) >= 0) {
                 // they are our friends
                 allies.push_back(m);
             } else {
@@ -839,19 +3169,156 @@ private:
         }
         // sort by risk
         sort(enemies.begin(), enemies.end(), [&](const auto & a, const auto & b) {
-            return eval_risk(m_ourBase, a) > eval_risk(m_ourBase, b);
+            return our_risk(a) > our_risk(b);
         });
-        sort(neutral.begin(), neutral.end(), [&](const auto & a, const auto & b) {
-            return eval_risk(m_theirBase, a) > eval_risk(m_theirBase, b);
+        // only the top of the passengers and of the allies is ever looked at
+        auto top = [](vector<Monster> & v) { return v.begin() + std::min<size_t>(kHerosPerPlayer, v.size()); };
+        partial_sort(neutral.begin(), top(neutral), neutral.end(), [&](const auto & a, const auto & b) {
+            return their_risk(a) > their_risk(b);
         });
-        sort(allies.begin(), allies.end(), [&](const auto & a, const auto & b) {
-            return eval_risk(m_theirBase, a) > eval_risk(m_theirBase, b);
+        partial_sort(allies.begin(), top(allies), allies.end(), [&](const auto & a, const auto & b) {
+            return their_risk(a) > their_risk(b);
         });
-        swap(m_enemies, enemies);
-        swap(m_neutral, neutral);
-        swap(m_allies, allies);
     }
 
+    // the eta and the risk of every monster against both bases, once per turn
+    void compute_features() {
+        // the distances from all the monsters to all our heros
+        int heros = m_heros.size();
+        int stride = m_table.padded();
+        auto toHeros = scratch<int>();
+        toHeros.resize(heros * stride);
+        for (int h = 0; h < heros; ++h) {
+            m_table.distances2(m_heros[h].pos, toHeros.data() + h * stride);
+        }
+        // what each hero reaches, in one pass per hero
+        for (int h = 0; h < std::min(heros, kHerosPerPlayer); ++h) {
+            m_table.masks(m_heros[h].pos, kReachRadius, kReaches, m_reach[h]);
+        }
+        m_unshielded = m_table.unshielded();
+
+        m_features.resize(m_world.capacity());
+        for (size_t i = 0; i < m_monsters.size(); ++i) {
+            const auto & m = m_monsters[i];
+            auto & f = features(m);
+            f.row = i;
+            f.eta[0] = m_forecast.eta(i, 0);
+            f.eta[1] = m_forecast.eta(i, 1);
+            // beyond the horizon: on its straight line
+            if (f.eta[0] == MonsterForecast::kUnknown) f.eta[0] = m.eta(m_ourBase);
+            if (f.eta[1] == MonsterForecast::kUnknown) f.eta[1] = m.eta(m_theirBase);
+            f.risk[0] = eval_risk(m, f.eta[0]);
+            f.risk[1] = eval_risk(m, f.eta[1]);
+            // the first one on a tie
+            f.nearestHero = f.nearestDefender = 0;
+            for (int h = 1; h < heros; ++h) {
+                int d2 = toHeros[h * stride + i];
+                if (d2 < toHeros[f.nearestHero * stride + i]) f.nearestHero = h;
+                if (h < kNumberOfDefenders && d2 < toHeros[f.nearestDefender * stride + i]) {
+                    f.nearestDefender = h;
+                }
+            }
+        }
+    }
+
+    // refresh the events of the monsters which did not do what was predicted (only the plan
+    // reads them: past the deadline, the turn is skipped and the next one forecasts all again)
+    void update_timeline() {
+        if (m_deadline.expired()) {
+            m_timeline.skip_turn();
+            return;
+        }
+        m_timeline.begin_turn();
+        for (size_t i = 0; i < m_monsters.size(); ++i) {
+            const auto & m = m_monsters[i];
+            bool near = within(m.pos, m_ourBase.pos, kMidCircle);
+            m_timeline.observe_monster(m_world.find(m.id).slot, m, m_forecast, i, near);
+        }
+        m_timeline.end_turn();
+    }
+
+    // the monster which hits our base first if nothing is done, among the ones already near
+    const Monster * next_to_reach_our_base() const {
+        if (m_timeline.empty()) return nullptr;
+        return &m_monsters[m_features[m_timeline.next().slot].row];
+    }
+
+    // where and when each of our heros can hit each monster first, once per turn (past the
+    // deadline, the heros go where the monsters are now)
+    void compute_intercepts() {
+        int heros = std::min<int>(m_heros.size(), kHerosPerPlayer);
+        int n = m_monsters.size();
+        bool late = m_deadline.expired();
+        m_intercepts.resize(heros * n);
+        for (int h = 0; h < heros; ++h) {
+            for (int i = 0; i < n; ++i) {
+                auto & x = m_intercepts[h * n + i];
+                x.turn = late ? MonsterForecast::kNever
+                              : m_forecast.intercept(i, m_heros[h].pos, kHeroSpeed, kHeroPhysicAttackRange);
+                x.point = x.turn == MonsterForecast::kNever ? m_monsters[i].pos : m_forecast.at(i, x.turn - 1);
+            }
+        }
+    }
+
+    const Intercept & intercept(int h, const Monster & m) const {
+        return m_intercepts[h * m_monsters.size() + row(m)];
+    }
+
+    // the turns for a hero to hit a monster of this turn (past the horizon if never)
+    int intercept_turns(int h, const Monster & m) const {
+        int t = intercept(h, m).turn;
+        return t == MonsterForecast::kNever ? MonsterForecast::kTurns + 1 : t;
+    }
+
+    // The targets of the free defenders among some monsters (indices, or AssignmentSolver::kIdle),
+    // jointly: each turn to intercept costs turnCost, less the risk of the monster, and staying
+    // idle costs idleCost. The first monster may be required to be taken. Past the deadline,
+    // the plan is dropped anyway: they all stay idle.
+    template <typename Monsters>
+    void assign_defenders(const Monsters & targets, int turnCost, int idleCost, bool first, int * out) {
+        PROFILE_SCOPE(StageAssignment);
+        if (m_deadline.expired()) {
+            std::fill(out, out + kNumberOfDefenders, (int) AssignmentSolver::kIdle);
+            return;
+        }
+        m_assignment.reset(kNumberOfDefenders, targets.size());
+        for (int h = 0; h < kNumberOfDefenders; ++h) {
+            if (m_heros[h].orderReceived()) continue;
+            m_assignment.set_idle(h, idleCost);
+            for (size_t t = 0; t < targets.size(); ++t) {
+                m_assignment.set(h, t, turnCost * intercept_turns(h, targets[t]) - our_risk(targets[t]));
+            }
+        }
+        if (first) m_assignment.require(0);
+        m_assignment.solve(out);
+        // a pass of plan() on a runner-up takes it where there is one
+        if (m_rank > 0 && m_rank < m_assignment.found()) {
+            m_assignment.ranked(m_rank, out);
+            m_ranked = true;
+        }
+    }
+
+    // the index of the defender nearest to a monster of this turn
+    int nearest_defender(const Monster & m) const { return features(m).nearestDefender; }
+
+    int row(const Monster & m) const { return features(m).row; }
+
+    // the monsters within a reach of one of our heros
+    const MonsterMask & reach(const Hero & hero, Reach r) const {
+        int h = 0;
+        while (h + 1 < kHerosPerPlayer && m_heros[h].id != hero.id) ++h;
+        return m_reach[h][r];
+    }
+
+    // cached features of a monster seen this turn
+    int our_eta(const Monster & m) const { return features(m).eta[0]; }
+    int their_eta(const Monster & m) const { return features(m).eta[1]; }
+    int our_risk(const Monster & m) const { return features(m).risk[0]; }
+    int their_risk(const Monster & m) const { return features(m).risk[1]; }
+
+    const MonsterFeatures & features(const Monster & m) const { return m_features[m_world.find(m.id).slot]; }
+    MonsterFeatures & features(const Monster & m) { return m_features[m_world.find(m.id).slot]; }
+
     void idle() {
         //for (int i = 0; i < kHerosPerPlayer; i++) {
         //    m_heros[i].wait();
@@ -876,7 +3343,8 @@ private:
     }
 
     void command_the_attacker_new() {
-        static int step = 0;
+        PROFILE_SCOPE(StageAttacker);
+        int & step = m_attackerStep;
 
         // short-cut: against all soccers
         if (m_allIn && step <= 2) {
@@ -922,18 +3390,18 @@ private:
     // rush to a given position
     bool rush_to_the_position(const Point & pos, bool summon = false) {
         auto & hero = m_heros[2];
-        int dist = distance(hero.pos, pos);
-        if (dist < 400) {
+        if (distance2(hero.pos, pos) < square(400)) {
             // arrived
             return true;
         }
 
         // could summon
         if (summon && m_ourBase.mp >= 3 * kMagicManaCost) {
-            auto monstersNearBy = hero.discover(m_monsters);
+            auto monstersNearBy = discover(hero.pos, kHeroViewRange);
             if (monstersNearBy.size() != 0) {
-                for (const auto & m : monstersNearBy) {
-                    if (m.eta(m_theirBase) < 0 && m.shield == 0 && (m.hp >= 16 || m_allIn)) {
+                for (int i : monstersNearBy) {
+                    const auto & m = m_monsters[i];
+                    if (their_eta(m) < 0 && m.shield == 0 && (m.hp >= 16 || m_allIn)) {
                         hero.control(m.id, m_theirBase.pos);
                         return false;
                     }
@@ -950,13 +3418,15 @@ private:
     // true if protected one ally
     bool wait_and_protect(const Point & pos) {
         auto & hero = m_heros[2];
-        auto monstersNearBy = hero.discover(m_monsters);
+        auto monstersNearBy = discover(hero.pos, kHeroViewRange);
         // sort by health and by eta
-        sort(monstersNearBy.begin(), monstersNearBy.end(), [&](const auto & a, const auto & b) {
+        sort(monstersNearBy.begin(), monstersNearBy.end(), [&](int i, int j) {
+            const auto & a = m_monsters[i];
+            const auto & b = m_monsters[j];
             if (a.hp > b.hp) {
                 return true;
             } else if (a.hp == b.hp) {
-                return eval_risk(m_theirBase, a) > eval_risk(m_theirBase, b);
+                return their_risk(a) > their_risk(b);
             } else {
                 return false;
             }
@@ -965,29 +3435,31 @@ private:
         if (m_ourBase.mp >= 3 * kMagicManaCost) {
             int dh = distance(m_theirBase.pos, hero.pos);
             if (dh < kMidCircle) {
-                for (const auto & m : monstersNearBy) {
+                for (int i : monstersNearBy) {
+                    const auto & m = m_monsters[i];
                     if (m.shield) continue;
 
                     // Use wind to boost the perf
                     int dm = distance(m_theirBase.pos, m.pos);
-                    int mh = distance(hero.pos, m.pos);
                     int diff = dm - dh;
-                    if (diff > 0 && mh < kRadiusOfWind && (m.hp >= 17 || m_allIn)) {
+                    if (diff > 0 && distance2(hero.pos, m.pos) < square(kRadiusOfWind) && (m.hp >= 17 || m_allIn)) {
                         hero.wind(m_theirBase.pos);
                         return true;
                     }
                 }
             }
             // protect first
-            for (const auto & m : monstersNearBy) {
+            for (int i : monstersNearBy) {
+                const auto & m = m_monsters[i];
                 if (shouldUseShieldSpell(hero, m)) {
                     hero.protect(m.id);
                     return true;
                 }
             }
             // then control
-            for (const auto & m : monstersNearBy) {
-                if (m.eta(m_theirBase) < 0 && m.shield == 0 && m.hp >= 16) {
+            for (int i : monstersNearBy) {
+                const auto & m = m_monsters[i];
+                if (their_eta(m) < 0 && m.shield == 0 && m.hp >= 16) {
                     hero.control(m.id, m_theirBase.pos);
                     return false;
                 }
@@ -1003,55 +3475,49 @@ private:
     void go_hunting() {
         auto & hero = m_heros[2];
 
-        auto monstersNearBy = hero.discover(m_monsters);
-        sort(monstersNearBy.begin(), monstersNearBy.end(), [&](const auto & a, const auto & b) {
-            int da = distance(a.pos, hero.pos);
-            int db = distance(b.pos, hero.pos);
+        auto monstersNearBy = discover(hero.pos, kHeroViewRange);
+        // the nearest first, then the highest risk (only the first one matters)
+        auto first = min_element(monstersNearBy.begin(), monstersNearBy.end(), [&](int i, int j) {
+            const auto & a = m_monsters[i];
+            const auto & b = m_monsters[j];
+            long long da = distance2(a.pos, hero.pos);
+            long long db = distance2(b.pos, hero.pos);
             if (da < db) {
                 return true;
             } else if (da == db) {
-                return eval_risk(m_ourBase, a) > eval_risk(m_ourBase, b);
+                return our_risk(a) > our_risk(b);
             } else {
                 return false;
             }
         });
         if (monstersNearBy.empty()) {
-            cruise_between_angles(hero, m_theirBase, 8500, 30, 60);
+            cruise_between_angles(hero, m_theirBase, 8500, 30, 60, m_goHighPos);
             hero.say("Faralë");
         } else {
             //hero.move(monstersNearBy.front().pos);
             //hero.say("Faralë");
             // may optimize the attack
-            auto monster = monstersNearBy.front();
+            const auto & monster = m_monsters[*first];
             if (monstersNearBy.size() >= 2) {
-                vector<Point> points;
-                for (const auto & m : monstersNearBy) {
-                    points.push_back(m.pos);
+                auto points = scratch<Point>();
+                for (int i : monstersNearBy) {
+                    points.push_back(m_monsters[i].pos);
                 }
 
-                // position and counts
-                vector<pair<Point, int>> res = NaiveOptimiser::solve(points, kHeroPhysicAttackRange);
-                if (!res.empty()) {
-                    sort(res.begin(), res.end(), [&](const auto & p1, const auto & p2) {
-                        if (p1.second > p2.second) {
-                            return true;
-                        } else if (p1.second == p2.second) {
-                            return distance(hero.pos, p1.first) < distance(hero.pos, p2.first);
-                        } else {
-                            return false;
-                        }
-                    });
-                    auto originalTargets = discover_in_range(m_monsters, monster.pos, kHeroPhysicAttackRange);
-                    auto plan = res.front();
-                    cerr << "Optimizer ON: init plan=" << monster.pos << "; cnt=" << originalTargets.size() << endl;
-                    cerr << "Optimizer ON: corrected plan=" << plan.first << "; cnt=" << plan.second << endl;
+                // position and counts (the nearest to the hero on a tie)
+                auto plan = m_optimiser.solve(points, kHeroPhysicAttackRange, hero.pos);
+                int originalTargets = m_table.count_within(monster.pos, kHeroPhysicAttackRange);
+                log() << "Optimizer ON: init plan=" << monster.pos << "; cnt=" << originalTargets << endl;
+                log() << "Optimizer ON: corrected plan=" << plan.first << "; cnt=" << plan.second << endl;
+                // a circle of a single monster: better met where it is first hit
+                if (plan.second >= 2) {
                     hero.move(plan.first);
                     hero.say("Aragorn");
                 }
             }
 
             if (!hero.orderReceived()) {
-                hero.move(monster.pos);
+                hero.move(intercept(2, monster).point);
                 hero.say("Faralë");
             }
         }
@@ -1060,25 +3526,26 @@ private:
     void summon_allies() {
         auto & hero = m_heros[2];
 
-        auto dist = distance(hero.pos, m_theirBase.pos);
-        auto monstersNearBy = hero.discover(m_monsters);
+        long long dist = distance2(hero.pos, m_theirBase.pos);
+        auto monstersNearBy = discover(hero.pos, kHeroViewRange);
         if (monstersNearBy.empty()) {
             // switch area
-            cruise_between_angles(hero, m_theirBase, kOutterCircle, 15, 75);
+            cruise_between_angles(hero, m_theirBase, kOutterCircle, 15, 75, m_goHighPos);
             hero.say("Attack");
         } else {
             if (m_ourBase.mp >= 4 * kMagicManaCost) {
                 // when I'm far from their base
-                if (dist >= kOutterCircle) {
+                if (dist >= square(kOutterCircle)) {
                     // the most important thing
-                    for (const auto & m : monstersNearBy) {
-                        if (m.eta(m_theirBase) < 0 && m.shield == 0 && m.hp >= 18) {
+                    for (int i : monstersNearBy) {
+                        const auto & m = m_monsters[i];
+                        if (their_eta(m) < 0 && m.shield == 0 && m.hp >= 18) {
                             hero.control(m.id, m_theirBase.pos);
                             return;
                         }
                     }
-                    auto throwables = hero.estimateWindAttackVictims(monstersNearBy);
-                    if (shouldUseWindSpell(hero, monstersNearBy) && throwables.size() > 2) {
+                    int throwables = estimateWindAttackVictims(hero);
+                    if (shouldUseWindSpell(hero, monstersNearBy) && throwables > 2) {
                         hero.wind(m_theirBase.pos);
                         return;
                     }
@@ -1089,18 +3556,20 @@ private:
                     return;
                 }
                 // sort from the highest risk to the lowest
-                sort(monstersNearBy.begin(), monstersNearBy.end(), [&](const auto & a, const auto & b) {
-                    return eval_risk(m_theirBase, a) > eval_risk(m_theirBase, b);
+                sort(monstersNearBy.begin(), monstersNearBy.end(), [&](int i, int j) {
+                    return their_risk(m_monsters[i]) > their_risk(m_monsters[j]);
                 });
-                for (const auto & m : monstersNearBy) {
+                for (int i : monstersNearBy) {
+                    const auto & m = m_monsters[i];
                     if (shouldUseShieldSpell(hero, m)) {
                         hero.protect(m.id);
                         return;
                     }
                 }
                 // pull the monster back
-                for (const auto & m : monstersNearBy) {
-                    if (m.eta(m_theirBase) < 0 && m.shield == 0) {
+                for (int i : monstersNearBy) {
+                    const auto & m = m_monsters[i];
+                    if (their_eta(m) < 0 && m.shield == 0) {
                         hero.control(m.id, m_theirBase.pos);
                         return;
                     }
@@ -1108,7 +3577,7 @@ private:
             }
             if (!hero.orderReceived()) {
                 // switch area
-                cruise_between_angles(hero, m_theirBase, kOutterCircle, 15, 75);
+                cruise_between_angles(hero, m_theirBase, kOutterCircle, 15, 75, m_goHighPos);
                 hero.say("Attack");
             }
         }
@@ -1117,38 +3586,40 @@ private:
     void range_and_protect() {
         auto & hero = m_heros[2];
 
-        auto monstersNearBy = hero.discover(m_monsters);
+        auto monstersNearBy = discover(hero.pos, kHeroViewRange);
         if (monstersNearBy.empty()) {
             // switch area
-            cruise_between_angles(hero, m_theirBase, kMidCircle, 15, 75);
+            cruise_between_angles(hero, m_theirBase, kMidCircle, 15, 75, m_goHighPos);
             hero.say("Focus");
         } else {
             if (m_ourBase.mp >= 3 * kMagicManaCost) {
                 // sort from the highest risk to the lowest
-                sort(monstersNearBy.begin(), monstersNearBy.end(), [&](const auto & a, const auto & b) {
-                    return eval_risk(m_theirBase, a) > eval_risk(m_theirBase, b);
+                sort(monstersNearBy.begin(), monstersNearBy.end(), [&](int i, int j) {
+                    return their_risk(m_monsters[i]) > their_risk(m_monsters[j]);
                 });
-                for (const auto & m : monstersNearBy) {
+                for (int i : monstersNearBy) {
+                    const auto & m = m_monsters[i];
                     if (shouldUseShieldSpell(hero, m)) {
                         hero.protect(m.id);
                         break;
                     }
                 }
                 if (!hero.orderReceived()) {
-                    for (const auto & m : monstersNearBy) {
-                        if (m.eta(m_theirBase) < 0 && m.hp >= 20 && m.shield == 0) {
+                    for (int i : monstersNearBy) {
+                        const auto & m = m_monsters[i];
+                        if (their_eta(m) < 0 && m.hp >= 20 && m.shield == 0) {
                             hero.control(m.id, m_theirBase.pos);
                             break;
                         }
                     }
                 }
-                if (!hero.orderReceived() && canUseWindSpell(hero, m_enemies)) {
+                if (!hero.orderReceived() && canUseWindSpellOnEnemies(hero)) {
                     hero.wind(m_theirBase.pos);
                 }
             }
             if (!hero.orderReceived()) {
                 //hero.move(m_theirBase, kInnerCircle, 45);
-                cruise_between_angles(hero, m_theirBase, kMidCircle, 15, 75);
+                cruise_between_angles(hero, m_theirBase, kMidCircle, 15, 75, m_goHighPos);
                 hero.say("Heru");
             }
         }
@@ -1158,45 +3629,55 @@ private:
     bool optimized_range_attack(int idx, const Monster & monster) {
         auto & hero = m_heros[idx];
         if (hero.orderReceived()) {
-            cerr << "Warning: " << hero  << "not available" << endl;
-            cerr << "cannot attack " << monster << endl;
+            log() << "Warning: " << hero  << "not available" << endl;
+            log() << "cannot attack " << monster << endl;
             return false;
         }
 
-        auto monstersNearBy = discover_in_range(m_monsters, monster.pos, kHeroViewRange);
-        auto originalTargets = discover_in_range(m_monsters, monster.pos, kHeroPhysicAttackRange);
+        auto monstersNearBy = discover(monster.pos, kHeroViewRange);
+        int originalTargets = m_table.count_within(monster.pos, kHeroPhysicAttackRange);
         // may optimize the attack
         if (monstersNearBy.size() >= 2) {
-            vector<Point> points;
-            for (const auto & m : monstersNearBy) {
+            auto points = scratch<Point>();
+            auto weights = scratch<int>();
+            auto hits = scratch<int>();
+            int target = -1;
+            for (int i : monstersNearBy) {
+                const auto & m = m_monsters[i];
+                if (m.id == monster.id) target = points.size();
                 points.push_back(m.pos);
+                // the threats weigh more
+                weights.push_back(1 + our_risk(m));
+                hits.push_back((std::max(m.hp, 1) + kHeroPhysicAttackDmg - 1) / kHeroPhysicAttackDmg);
+            }
+            // our monster outweighs all the others together: the circle encloses it
+            if (target >= 0) {
+                weights[target] = 1;
+                for (int k = 0; k < (int) weights.size(); ++k) {
+                    if (k != target) weights[target] += weights[k];
+                }
             }
 
-            // position and counts
-            vector<pair<Point, int>> res = NaiveOptimiser::solve(points, kHeroPhysicAttackRange);
-            if (!res.empty()) {
-                sort(res.begin(), res.end(), [&](const auto & p1, const auto & p2) {
-                    if (p1.second > p2.second) {
-                        return true;
-                    } else if (p1.second == p2.second) {
-                        return distance(m_ourBase.pos, p1.first) < distance(m_ourBase.pos, p2.first);
-                    } else {
-                        return false;
-                    }
-                });
-                auto plan = res.front();
-                cerr << "Optimizer ON: init plan=" << monster.pos << "; cnt=" << originalTargets.size() << endl;
-                cerr << "Optimizer ON: corrected plan=" << plan.first << "; cnt=" << plan.second << endl;
+            // position and weight (the nearest to our base on a tie), around the circle of the
+            // other defender if it has one this turn
+            int j = other_defencer(idx);
+            auto plan = m_cover.solve(points, weights, hits, 1, kHeroPhysicAttackRange, m_ourBase.pos,
+                                      &m_circle[j], m_hasCircle[j] ? 1 : 0);
+            // a circle of a single monster: better met where it is first hit
+            if (__builtin_popcountll(plan.enclosed[0]) >= 2) {
+                log() << "Optimizer ON: init plan=" << monster.pos << "; cnt=" << originalTargets << endl;
+                log() << "Optimizer ON: corrected plan=" << plan.centers[0] << "; weight=" << plan.weight << endl;
                 Action a;
                 a.subject = idx;
                 a.verb = MOVE;
-                a.dest = plan.first;
+                a.dest = plan.centers[0];
                 a.msg = "Aragorn";
                 m_queue.push(a);
                 hero.end();
-                int dist = distance(a.dest, monster.pos);
+                m_circle[idx] = a.dest;
+                m_hasCircle[idx] = true;
                 // the init target is enclosed in the circle
-                return dist < kHeroPhysicAttackRange;
+                return target >= 0 && (plan.enclosed[0] >> target) & 1;
             }
         }
 
@@ -1204,7 +3685,8 @@ private:
             Action a;
             a.subject = idx;
             a.verb = MOVE;
-            a.dest = monster.pos;
+            // where it will be when we meet
+            a.dest = intercept(idx, monster).point;
             a.object = monster.id;
             a.msg = "Focus!";
             m_queue.push(a);
@@ -1218,8 +3700,8 @@ private:
     void attack_the_monster(int idx, Monster & monster) {
         auto & hero = m_heros[idx];
         if (hero.orderReceived()) {
-            cerr << "Warning: " << hero  << "not available" << endl;
-            cerr << "cannot attack " << monster << endl;
+            log() << "Warning: " << hero  << "not available" << endl;
+            log() << "cannot attack " << monster << endl;
             return;
         }
 
@@ -1228,16 +3710,9 @@ private:
             // Wind attack
             if (canUseWindSpell(hero, monster)) {
                 // find on the opponents near our base
-                auto opponentsNearOurBase =
-                    discover_in_range(m_opponents, m_ourBase.pos, kMidCircle);
-                // sort by the distance to my base (nearest to farest)
-                sort(opponentsNearOurBase.begin(), opponentsNearOurBase.end(), [&](int id1, int id2) {
-                    auto pos1 = m_world[id1].pos;
-                    auto pos2 = m_world[id2].pos;
-                    return distance(pos1, m_ourBase.pos) < distance(pos2, m_ourBase.pos);
-                });
+                auto opponentsNearOurBase = opponents_near_our_base(kMidCircle);
                 bool shallUseWind = opponentsNearOurBase.size() != 0 &&
-                    (distance(m_world[opponentsNearOurBase.front()].pos, monster.pos) <= kHeroViewRange);
+                    within(m_world.get(opponentsNearOurBase.front()).pos, monster.pos, kHeroViewRange);
                 if (shallUseWind || !canEliminateMonster(hero, monster)) {
                     Action a;
                     a.subject = idx;
@@ -1284,19 +3759,27 @@ private:
         hero.end();
     }
 
+    // the opponents around our base, from the nearest to the farthest
+    ArenaVector<EntityHandle> opponents_near_our_base(int range) const {
+        auto ans = scratch<EntityHandle>();
+        for (const auto & h : m_opponents) {
+            if (within(h.pos, m_ourBase.pos, range)) {
+                ans.push_back(m_world.find(h.id));
+            }
+        }
+        sort(ans.begin(), ans.end(), [&](EntityHandle h1, EntityHandle h2) {
+            auto pos1 = m_world.get(h1).pos;
+            auto pos2 = m_world.get(h2).pos;
+            return distance2(pos1, m_ourBase.pos) < distance2(pos2, m_ourBase.pos);
+        });
+        return ans;
+    }
+
     void update_the_default_positions() {
         // find on the opponents near our base
-        auto opponentsNearOurBase =
-            discover_in_range(m_opponents, m_ourBase.pos, kMidCircle);
-        // sort by the distance to my base (nearest to farest)
-        sort(opponentsNearOurBase.begin(), opponentsNearOurBase.end(), [&](int id1, int id2) {
-            auto pos1 = m_world[id1].pos;
-            auto pos2 = m_world[id2].pos;
-            return distance(pos1, m_ourBase.pos) < distance(pos2, m_ourBase.pos);
-        });
+        auto opponentsNearOurBase = opponents_near_our_base(kMidCircle);
         for (int idx = 0; idx < kNumberOfDefenders && idx < opponentsNearOurBase.size(); ++idx) {
-            auto & opponent = m_world[opponentsNearOurBase[idx]];
-            int dist = distance(opponent.pos, m_ourBase.pos);
+            const auto & opponent = m_world.get(opponentsNearOurBase[idx]);
             int radius = kMidCircle;
             int degree = calc_degree_between(m_ourBase.pos, opponent.pos);
             Point p = compute_cartesian_point(m_ourBase, radius, degree);
@@ -1336,9 +3819,8 @@ private:
 
             int j = other_defencer(idx);
             auto & other = m_heros[j];
-            int dist = distance(hero.pos, other.pos);
             // try to protect each other
-            if (hero.mad && dist < kHeroViewRange && m_ourBase.mp >= kMagicManaCost) {
+            if (hero.mad && distance2(hero.pos, other.pos) < square(kHeroViewRange) && m_ourBase.mp >= kMagicManaCost) {
                 Action a;
                 a.subject = idx;
                 a.verb = MOVE;
@@ -1365,27 +3847,21 @@ private:
         if (m_queue.size() >= kNumberOfDefenders) return;
         if (m_ourBase.mp < kMagicManaCost) return;
 
-        vector<Monster> enemiesNearOurBase;
-        for (const auto & m : m_enemies) {
-            int dist = distance(m.pos, m_ourBase.pos);
-            if (dist <= kMidCircle) {
-                enemiesNearOurBase.push_back(m);
-            }
-        }
-        if (enemiesNearOurBase.empty()) return;
+        const auto * next = next_to_reach_our_base();
+        if (next == nullptr) return;
 
-        auto & monster = enemiesNearOurBase.front();
+        const auto & monster = *next;
         // cannot pull it back
         if (monster.shield > 0) return;
 
-        int idx = find_nearest_defender(monster, m_heros);
+        int idx = nearest_defender(monster);
         auto & hero = m_heros[idx];
         int j = other_defencer(idx);
         auto & other = m_heros[j];
-        int eta = monster.eta(m_ourBase);
+        int eta = our_eta(monster);
         if (!hero.orderReceived()) {
-            int dist = distance(hero.pos, monster.pos);
-            if (dist <= kHeroViewRange) {
+            if (m_reach[idx][ReachView].test(row(monster))) {
+                int dist = distance(hero.pos, monster.pos);
                 // round up
                 int turns = (dist + kHeroSpeed) / kHeroSpeed;
                 if (turns >= eta - 1) {
@@ -1403,8 +3879,8 @@ private:
                 }
             }
         } else {
-            int dist = distance(other.pos, monster.pos);
-            if (dist <= kHeroViewRange) {
+            if (m_reach[j][ReachView].test(row(monster))) {
+                int dist = distance(other.pos, monster.pos);
                 int turns = (dist + kHeroSpeed) / kHeroSpeed;
                 if (turns >= eta - 1) {
                     Action a;
@@ -1424,6 +3900,8 @@ private:
     }
 
     void command_the_defenders_new() {
+        PROFILE_SCOPE(StageDefenders);
+        std::fill(m_hasCircle, m_hasCircle + kNumberOfDefenders, false);
         update_the_default_positions();
         // step 1
         self_protections();
@@ -1431,76 +3909,60 @@ private:
         pull_it_back();
         if (m_queue.size() >= kNumberOfDefenders) return;
 
-        vector<Monster> enemiesNearOurBase;
+        auto enemiesNearOurBase = scratch<Monster>();
         for (const auto & m : m_enemies) {
-            int dist = distance(m.pos, m_ourBase.pos);
-            if (dist <= kMidCircle) {
+            if (within(m.pos, m_ourBase.pos, kMidCircle)) {
                 enemiesNearOurBase.push_back(m);
             }
         }
 
-        // highest priority (per monster)
+        // the first one to hit our base goes first
+        if (const auto * next = next_to_reach_our_base()) {
+            auto first = find_if(enemiesNearOurBase.begin(), enemiesNearOurBase.end(), [&](const auto & m) {
+                return m.id == next->id;
+            });
+            if (first != enemiesNearOurBase.end()) rotate(enemiesNearOurBase.begin(), first, first + 1);
+        }
+
+        // highest priority: the first monster, then the other defender on its best target
         if (enemiesNearOurBase.size() != 0) {
-            // must handle the first monster
+            int target[kNumberOfDefenders];
+            assign_defenders(enemiesNearOurBase, kInterceptTurnCost, kIdleDefenderCost, true, target);
             auto & monster = enemiesNearOurBase.front();
-            int idx = find_nearest_defender(monster, m_heros);
-            auto & hero = m_heros[idx];
+            int idx = std::find(target, target + kNumberOfDefenders, 0) - target;
+            if (idx == kNumberOfDefenders) idx = nearest_defender(monster);
             attack_the_monster(idx, monster);
 
             int j = other_defencer(idx);
-            auto & other = m_heros[j];
             if (monster.hp > 0) {
                 attack_the_monster(j, monster);
                 return;
             }
-
-            auto monstersNearBy = other.discover(enemiesNearOurBase);
-            // sort by distance (to the hero) and by risk
-            sort(monstersNearBy.begin(), monstersNearBy.end(), [&](const auto & a, const auto & b) {
-                int da = distance(a.pos, other.pos);
-                int db = distance(b.pos, other.pos);
-                if (da < db) {
-                    return true;
-                } else if (da == db) {
-                    return eval_risk(m_ourBase, a) > eval_risk(m_ourBase, b);
-                } else {
-                    return false;
-                }
-            });
-
-            // attack the nearest monster
-            for (auto & m : monstersNearBy) {
-                if (m.hp < 0) continue;
-                attack_the_monster(j, m);
-                return;
-            }
-
-            // attack the second enemy
-            for (auto & m : enemiesNearOurBase) {
-                if (m.hp < 0) continue;
-                attack_the_monster(j, m);
+            if (target[j] > 0) {
+                attack_the_monster(j, enemiesNearOurBase[target[j]]);
                 return;
             }
         }
         if (m_queue.size() >= kNumberOfDefenders) return;
 
-        // lower priority: farm the monsters in the wild (per monster)
-        vector<Monster> monstersInTheWild;
-        for (const auto & m : m_monsters) {
-            int dist = distance(m.pos, m_ourBase.pos);
-            if (dist > kMidCircle && dist <= kOutterCircle) {
+        // lower priority: farm the monsters in the wild, the free defenders together
+        auto monstersInTheWild = scratch<Monster>();
+        for (int i : discover(m_ourBase.pos, kOutterCircle)) {
+            const auto & m = m_monsters[i];
+            if (!within(m.pos, m_ourBase.pos, kMidCircle) && m.hp >= 0) {
                 monstersInTheWild.push_back(m);
             }
         }
-        for (int idx = 0; idx < monstersInTheWild.size() && m_queue.size() < kNumberOfDefenders; ++idx) {
-            auto & monster = monstersInTheWild[idx];
-            if (monster.hp < 0) continue;
-
-            int i = find_nearest_defender(monster, m_heros);
-            auto & hero = m_heros[i];
-            if (hero.orderReceived()) continue;
-
-            attack_the_monster(i, monster);
+        if (!monstersInTheWild.empty()) {
+            int target[kNumberOfDefenders];
+            // a turn to intercept costs one, less the risk of the monster, and the post costs
+            // kFarmingTurns: a harmless monster is farmed if intercepted within that many turns,
+            // one with a risk of r from r turns further (even past the horizon, which counts
+            // as kTurns + 1, once r is over kTurns + 1 - kFarmingTurns)
+            assign_defenders(monstersInTheWild, 1, kFarmingTurns, false, target);
+            for (int i = 0; i < kNumberOfDefenders; ++i) {
+                if (target[i] != AssignmentSolver::kIdle) attack_the_monster(i, monstersInTheWild[target[i]]);
+            }
         }
 
         // default operation
@@ -1549,37 +4011,27 @@ private:
             default: throw("unknow phase");
         }
         // find on the opponents near our base
-        auto opponentsNearOurBase =
-            discover_in_range(m_opponents, m_ourBase.pos, kOutterCircle);
-        // sort by the distance to my base (nearest to farest)
-        sort(opponentsNearOurBase.begin(), opponentsNearOurBase.end(), [&](int id1, int id2) {
-            auto pos1 = m_world[id1].pos;
-            auto pos2 = m_world[id2].pos;
-            return distance(pos1, m_ourBase.pos) < distance(pos2, m_ourBase.pos);
-        });
+        auto opponentsNearOurBase = opponents_near_our_base(kOutterCircle);
         bool alert = false;
         if (opponentsNearOurBase.size() != 0) {
             alert = true;
 
-            int id = opponentsNearOurBase.front();
-            auto & opponent = m_world[id];
+            const auto & opponent = m_world.get(opponentsNearOurBase.front());
             int dist = distance(opponent.pos, m_ourBase.pos);
             radiusOfDefence = std::min(kMidCircle, dist);
             defaultAngles[0] = calc_degree_between(m_ourBase.pos, opponent.pos);
             defaultAngles[1] = defaultAngles[0] + 30;
         }
         if (opponentsNearOurBase.size() > 1) {
-            int id = opponentsNearOurBase[1];
-            auto & opponent = m_world[id];
+            const auto & opponent = m_world.get(opponentsNearOurBase[1]);
             defaultAngles[1] = calc_degree_between(m_ourBase.pos, opponent.pos);
         }
 
         // per hero
         for (int i = 0; i < kNumberOfDefenders; ++i) {
             auto & hero = m_heros[i];
-            auto dist = distance(hero.pos, m_ourBase.pos);
             // stage2: do not go too far
-            if (dist > radiusOfDefence + 1500) {
+            if (!within(hero.pos, m_ourBase.pos, radiusOfDefence + 1500)) {
                 // back to the default position
                 Action a;
                 a.subject = i;
@@ -1594,10 +4046,10 @@ private:
 
             // stage3: no enemies at all
             if (m_enemies.empty() && opponentsNearOurBase.empty()) {
-                auto monstersNearBy = hero.discover(m_monsters);
+                auto monstersNearBy = monsters_in_range(hero.pos, kHeroViewRange);
                 // sort from the nearest to the farest
                 sort(monstersNearBy.begin(), monstersNearBy.end(), [&](const auto & a, const auto & b) {
-                    return distance(a.pos, hero.pos) < distance(b.pos, hero.pos);
+                    return distance2(a.pos, hero.pos) < distance2(b.pos, hero.pos);
                 });
                 Action a;
                 a.subject = i;
@@ -1620,10 +4072,10 @@ private:
         if (m_queue.size() >= kNumberOfDefenders) return;
 
         // stage4: focus on the enemies in our base
-        auto monstersInOurBase = discover_in_range(m_monsters, m_ourBase.pos, kRadiusOfBase);
+        auto monstersInOurBase = monsters_in_range(m_ourBase.pos, kRadiusOfBase);
         // sort by risk (highest to lowest)
         sort(monstersInOurBase.begin(), monstersInOurBase.end(), [&](const auto & a, const auto & b) {
-            return eval_risk(m_ourBase, a) > eval_risk(m_ourBase, b);
+            return our_risk(a) > our_risk(b);
         });
         // per monster now
         int x = 0;
@@ -1634,7 +4086,7 @@ private:
                 continue;
             }
 
-            int idx = find_nearest_defender(monster, m_heros);
+            int idx = nearest_defender(monster);
             // this hero is not available
             if (m_heros[idx].orderReceived()) {
                 // must handle the first monster
@@ -1684,10 +4136,10 @@ private:
 
             // no alert => go farm
             if (!alert) {
-                auto monstersNearBy = hero.discover(m_monsters);
+                auto monstersNearBy = monsters_in_range(hero.pos, kHeroViewRange);
                 // sort by distance to my hero (nearest to farest)
                 sort(monstersNearBy.begin(), monstersNearBy.end(), [&](const auto & a, const auto & b) {
-                    return distance(a.pos, hero.pos) < distance(b.pos, hero.pos);
+                    return distance2(a.pos, hero.pos) < distance2(b.pos, hero.pos);
                 });
 
                 if (monstersNearBy.size() != 0) {
@@ -1723,10 +4175,10 @@ private:
 
     bool canEliminateMonster(const Hero & hero, const Monster & monster) {
         if (monster.hp < 0) {
-            cerr << "Warning [Negative HP]: " << monster << endl;
+            log() << "Warning [Negative HP]: " << monster << endl;
             return true;
         }
-        auto eta = monster.eta(m_ourBase);
+        auto eta = our_eta(monster);
         if (eta < 0) return true;
 
         if (monster.hp < eta * kHeroPhysicAttackDmg) {
@@ -1736,18 +4188,16 @@ private:
     }
 
     bool canUseWindSpell(const Hero & hero, const Monster & monster) const {
-        int dist = distance(hero.pos, monster.pos);
-        if (dist <= kRadiusOfWind && m_ourBase.mp >= kMagicManaCost && monster.shield == 0) {
+        if (reach(hero, ReachWind).test(row(monster)) && m_ourBase.mp >= kMagicManaCost && monster.shield == 0) {
             return true;
         }
         return false;
     }
 
-    bool canUseWindSpell(const Hero & hero, const vector<Monster> & monsters) const {
-        for (const auto & m : monsters) {
-            if (canUseWindSpell(hero, m)) return true;
-        }
-        return false;
+    // whether a wind would push one of the enemies
+    bool canUseWindSpellOnEnemies(const Hero & hero) const {
+        if (m_ourBase.mp < kMagicManaCost) return false;
+        return (reach(hero, ReachWind) & m_enemyMask & m_unshielded).any();
     }
 
     bool shouldSelfProtect(const Hero & hero) const {
@@ -1761,33 +4211,72 @@ private:
 
     // for attacker only
     bool shouldUseWindSpell(const Hero & hero, const Monster & monster) const {
-        int dh = distance(monster.pos, hero.pos);
-        int db = distance(monster.pos, m_theirBase.pos);
-        if (  dh <= kRadiusOfWind
-           && db <= 7000
+        if (  reach(hero, ReachWind).test(row(monster))
+           && within(monster.pos, m_theirBase.pos, 7000)
            && monster.shield == 0) {
             return true;
         }
         return false;
     }
 
-    bool shouldUseWindSpell(const Hero & hero, const vector<Monster> & monsters) const {
-        for (const auto & m : monsters) {
-            if (shouldUseWindSpell(hero, m)) return true;
+    bool shouldUseWindSpell(const Hero & hero, const ArenaVector<int> & monsters) const {
+        for (int i : monsters) {
+            if (shouldUseWindSpell(hero, m_monsters[i])) return true;
         }
         return false;
     }
 
+    // the number of monsters which would be pushed by a wind
+    int estimateWindAttackVictims(const Hero & hero) const {
+        return (reach(hero, ReachWind) & m_unshielded).count();
+    }
+
+    // the monsters in the range (their indices in m_monsters, in ascending order)
+    ArenaVector<int> discover(const Point & pos, int range) const {
+        auto ans = scratch<int>();
+        m_table.within(pos, range, ans);
+        return ans;
+    }
+
+    // the monsters in the range (copies, in the order of m_monsters)
+    ArenaVector<Monster> monsters_in_range(const Point & pos, int range) const {
+        auto ans = scratch<Monster>();
+        for (int i : discover(pos, range)) {
+            ans.push_back(m_monsters[i]);
+        }
+        return ans;
+    }
+
+    // the monsters of the list within the range (in the same order)
+    template <typename Monsters>
+    ArenaVector<Monster> select_in_range(const Monsters & monsters, const Point & pos, int range) const {
+        auto ans = scratch<Monster>();
+        for (const auto & m : monsters) {
+            if (within(m.pos, pos, range)) {
+                ans.push_back(m);
+            }
+        }
+        return ans;
+    }
+
+    // an empty vector in the memory of the turn
+    template <typename T>
+    ArenaVector<T> scratch() const {
+        return ArenaVector<T>(ArenaAllocator<T>(&m_arena));
+    }
+
     bool shouldUseShieldSpell(const Hero & hero, const Monster & monster) const {
-        auto eta = monster.eta(m_theirBase);
+        auto eta = their_eta(monster);
         if (  monster.shield == 0
            && eta >= 0
-           && eta <= 13) {
+           && eta <= m_params.shieldEta) {
             return true;
         }
         return false;
     }
 
+    Frame m_frame; // the real map from the canonical one
+    BrainParams m_params;
     Base m_ourBase;
     Base m_theirBase;
 
@@ -1795,26 +4284,54 @@ private:
     int m_madness;
     bool m_allIn;
     Phase m_phase;
-    bool m_blue;
+    int m_attackerStep; // of command_the_attacker_new()
+    bool m_goHighPos; // cruise_between_angles()
 
     Point m_startPos;
     Point m_endPos;
     Point m_attackPos;
     vector<Point> m_defaultPos;
 
-    queue<Action> m_queue;
+    FixedQueue<Action, kMaxActions> m_queue;
+    mutable TurnArena m_arena; // the temporaries of the turn
+    TurnOutput m_output;
+    std::ostream * m_log;
+    int m_timeBudget; // us per turn (0: no limit)
+    Deadline m_deadline; // of the turn
+    int m_passes; // plans made in the turn
+    int m_rank; // of the assignments of the defenders in this pass of plan() (0: the best)
+    bool m_ranked; // whether this pass took a runner-up
+    CircleCoverOptimiser m_optimiser; // for the attacker
+    JointCoverOptimiser m_cover; // for the defenders
+    Point m_circle[kNumberOfDefenders]; // where the defenders attack this turn
+    bool m_hasCircle[kNumberOfDefenders];
 
-    unordered_map<int, Entity> m_world;
+    EntityStore m_world;
 
 
     vector<Hero> m_heros;
     vector<Monster> m_monsters;
+    MonsterTable m_table; // over m_monsters
+    MonsterForecast m_forecast; // of m_monsters, by row
+    ThreatTimeline m_timeline; // the monsters near our base by the turn they hit it
+    AssignmentSolver m_assignment; // of the defenders
+    vector<Intercept> m_intercepts; // [hero * monsters + row]
+
+    // the reaches of our heros over the monsters (by row), computed once per turn
+    MonsterMask m_reach[kHerosPerPlayer][kReaches];
+    MonsterMask m_unshielded;
+    MonsterMask m_enemyMask; // m_enemies
+    vector<MonsterFeatures> m_features; // indexed by the slot of the monster in m_world
     vector<Hero> m_opponents;
     vector<Monster> m_enemies;
     vector<Monster> m_neutral;
     vector<Monster> m_allies;
 };
 
+// Offline tools (simulator, benchmarks) include this file with BRAIN_NO_MAIN
+// defined in order to drive Brain in-process.
+#ifndef BRAIN_NO_MAIN
+
 /**
  * Auto-generated code below aims at helping you parse
  * the standard input according to the problem statement.
@@ -1822,64 +4339,64 @@ private:
 
 int main()
 {
-    int base_x; // The corner of the map representing your base
-    int base_y;
-    cin >> base_x >> base_y; cin.ignore();
-    int heroes_per_player; // Always 3
-    cin >> heroes_per_player; cin.ignore();
+    // all the input goes through the reader, all the output through a single buffer
+    std::ios::sync_with_stdio(false);
+    InputReader in;
+    OutputBuffer out;
+
+    int base_x = in.next(); // The corner of the map representing your base
+    int base_y = in.next();
+    in.next(); // heroes_per_player, always 3
 
-    Base ourBase, theirBase;
-    ourBase.pos = Point(base_x, base_y);
-    theirBase.pos = Point(kWidth - base_x, kHeight - base_y);
-    Brain brain(ourBase, theirBase);
+    Brain brain;
+    brain.set_time_budget(kTurnTime);
+    brain.init(Point(base_x, base_y));
+
+    // reused from one turn to the next
+    TurnInput input;
+    input.units.reserve(kMaxEntities);
 
     // game loop
     while (1) {
         for (int i = 0; i < 2; i++) {
-            int health; // Your base health
-            int mana; // Spend ten mana to cast a spell
-            cin >> health >> mana; cin.ignore();
+            int health = in.next(); // Your base health
+            int mana = in.next(); // Spend ten mana to cast a spell
 
             if (i == 0) {
-                brain.updateOurBase(health, mana);
+                input.ours.update(health, mana);
             } else {
-                brain.updateTheirBase(health, mana);
+                input.theirs.update(health, mana);
             }
         }
-        int entity_count; // Amount of heros and monsters you can see
-        cin >> entity_count; cin.ignore();
-        vector<Entity> units;
+        int entity_count = in.next(); // Amount of heros and monsters you can see
+        if (!in.ok()) break;
+
+        input.units.clear();
         for (int i = 0; i < entity_count; i++) {
-            int id; // Unique identifier
-            int type; // 0=monster, 1=your hero, 2=opponent hero
-            int x; // Position of this entity
-            int y;
-            int shield_life; // Count down until shield spell fades
-            int is_controlled; // Equals 1 when this entity is under a control spell
-            int health; // Remaining health of this monster
-            int vx; // Trajectory of this monster
-            int vy;
-            int near_base; // 0=monster with no target yet, 1=monster targeting a base
+            Entity e;
+            e.id = in.next(); // Unique identifier
+            e.type = in.next(); // 0=monster, 1=your hero, 2=opponent hero
+            e.pos.x = in.next(); // Position of this entity
+            e.pos.y = in.next();
+            e.shield = in.next(); // Count down until shield spell fades
+            e.mad = in.next() ? true : false; // Equals 1 when this entity is under a control spell
+            e.hp = in.next(); // Remaining health of this monster
+            e.v.x = in.next(); // Trajectory of this monster
+            e.v.y = in.next();
+            e.target = in.next(); // 0=monster with no target yet, 1=monster targeting a base
             // Given this monster's trajectory,
             // is it a threat to 1=your base, 2=your opponent's base, 0=neither
-            int threat_for;
-            cin >> id >> type >> x >> y >> shield_life >> is_controlled >> health
-                >> vx >> vy >> near_base >> threat_for; cin.ignore();
-
-            Entity e;
-            e.id = id;
-            e.type = type;
-            e.pos = Point(x, y);
-            e.shield = shield_life;
-            e.mad = is_controlled ? true : false;
-            e.hp = health;
-            e.v = Point(vx, vy);
-            e.target = near_base;
-            e.threat = threat_for;
-            units.push_back(e);
-        }
-        brain.parse(units);
+            e.threat = in.next();
+            input.units.push_back(e);
+        }
+        brain.read(input);
         brain.showGameInfo(); // debug
-        brain.play();
+        const auto & output = brain.decide();
+        for (int i = 0; i < output.count; i++) {
+            out.append(output.lines[i]);
+        }
+        out.flush(cout);
     }
 }
+
+#endif // BRAIN_NO_MAIN
@@ -0,0 +1,62 @@
+// Convert the raw standard input of a match (as read by main() in game.cc)
+// into a binary replay.
+//
+// usage: record.out < match.txt > match.rpl
+
+#define BRAIN_NO_MAIN
+#include "game.cc"
+#include "replay.h"
+
+int main()
+{
+    InputReader in;
+    int base_x = in.next();
+    int base_y = in.next();
+    in.next(); // heroes_per_player
+    if (!in.ok()) {
+        cerr << "record: no header in the input" << endl;
+        return 1;
+    }
+
+    ReplayWriter writer(cout);
+    writer.begin(Point(base_x, base_y));
+
+    int turns = 0;
+    Base ours, theirs;
+    vector<Entity> units;
+    while (true) {
+        int health = in.next();
+        int mana = in.next();
+        if (!in.ok()) break;
+        ours.update(health, mana);
+        health = in.next();
+        mana = in.next();
+        theirs.update(health, mana);
+
+        int entity_count = in.next();
+        units.clear();
+        for (int i = 0; i < entity_count; i++) {
+            Entity e;
+            e.id = in.next();
+            e.type = in.next();
+            e.pos.x = in.next();
+            e.pos.y = in.next();
+            e.shield = in.next();
+            e.mad = in.next() ? true : false;
+            e.hp = in.next();
+            e.v.x = in.next();
+            e.v.y = in.next();
+            e.target = in.next();
+            e.threat = in.next();
+            units.push_back(e);
+        }
+        if (!in.ok()) {
+            cerr << "record: truncated turn " << turns + 1 << endl;
+            break;
+        }
+        writer.record(ours, theirs, units);
+        ++turns;
+    }
+    cerr << "record: " << turns << " turns" << endl;
+    return 0;
+}
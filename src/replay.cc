@@ -0,0 +1,132 @@
+// Replay a corpus of binary replays through Brain::step() at full speed.
+//
+// usage: replay.out [--trace trace.json] file.rpl...
+//
+// Reports the throughput and the latency percentiles of step().
+// Built with BRAIN_PROFILE (make profile), it also reports the time spent per
+// stage and can export a Chrome trace of the whole run. Built with
+// BRAIN_COUNT_ALLOCATIONS (make allocs), it reports the heap allocations of
+// step() once the brains are warmed up (which should be none).
+
+#define BRAIN_NO_MAIN
+#include "game.cc"
+#include "simulator.h"
+#include "replay.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const char * path) : m_data(nullptr), m_size(0) {
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void * p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                m_data = (const uint8_t *)p;
+                m_size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if (m_data) munmap((void *)m_data, m_size);
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    bool ok() const { return m_data != nullptr; }
+    const uint8_t * data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t * m_data;
+    size_t m_size;
+};
+
+// the first turns of a brain may size its buffers
+const int kWarmUpTurns = 10;
+
+double percentile(const vector<double> & sorted, double q) {
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(q * sorted.size()))];
+}
+
+int main(int argc, char ** argv)
+{
+    int first = 1;
+    string trace;
+    if (argc > 2 && string(argv[1]) == "--trace") {
+        trace = argv[2];
+        first = 3;
+    }
+    if (argc <= first) {
+        cerr << "usage: " << argv[0] << " [--trace trace.json] file.rpl..." << endl;
+        return 1;
+    }
+
+    vector<double> latencies; // in microseconds
+#ifdef BRAIN_COUNT_ALLOCATIONS
+    size_t allocations = 0; // after the warm-up
+#endif
+    int files = 0;
+    auto start = std::chrono::steady_clock::now();
+    {
+        TurnInput input;
+        for (int i = first; i < argc; ++i) {
+            MappedFile file(argv[i]);
+            if (!file.ok()) continue;
+            ReplayReader reader(file.data(), file.size());
+            if (!reader.ok()) continue;
+            ++files;
+
+            // the brains are very talkative
+            Brain brain;
+            brain.set_log(nullptr);
+            brain.init(reader.base());
+            for (int turn = 0; reader.next(input.ours, input.theirs, input.units); ++turn) {
+#ifdef BRAIN_COUNT_ALLOCATIONS
+                size_t before = g_allocations;
+#endif
+                auto t0 = std::chrono::steady_clock::now();
+                brain.step(input);
+                auto t1 = std::chrono::steady_clock::now();
+#ifdef BRAIN_COUNT_ALLOCATIONS
+                if (turn >= kWarmUpTurns) allocations += g_allocations - before;
+#endif
+                latencies.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+            }
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    sort(latencies.begin(), latencies.end());
+    cout << "files=" << files << "; turns=" << latencies.size() << "; elapsed=" << elapsed.count() << "s";
+    cout << "; turns/s=" << (long long)(latencies.size() / elapsed.count()) << endl;
+    cout << "latency(us): p50=" << percentile(latencies, 0.5) << "; p90=" << percentile(latencies, 0.9);
+    cout << "; p99=" << percentile(latencies, 0.99) << "; max=" << percentile(latencies, 1.0) << endl;
+
+#ifdef BRAIN_COUNT_ALLOCATIONS
+    cout << "allocations after " << kWarmUpTurns << " turns: " << allocations << endl;
+#endif
+
+#ifdef BRAIN_PROFILE
+    Profiler::instance().report(cout);
+    if (!trace.empty() && !Profiler::instance().export_chrome_trace(trace)) return 1;
+#else
+    if (!trace.empty()) {
+        cerr << "The trace needs a profiling build (make profile)" << endl;
+        return 1;
+    }
+#endif
+    return files == argc - first ? 0 : 1;
+}
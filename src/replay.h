@@ -0,0 +1,204 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// Compact binary record of what one player sees during a game.
+//
+// It must be included right after game.cc (compiled with BRAIN_NO_MAIN).
+//
+// Layout (all integers are LEB128 varints, signed ones are zigzag encoded):
+//   header: "SPRP" version base_x base_y
+//   turn:   d(our hp) d(our mp) d(their hp) d(their mp) entity_count entity*
+//   entity: d(id) flags x y shield hp vx vy
+//
+// d() is the delta from the previous turn (or from the previous id within the
+// same turn). The flags hold type (2 bits), mad, target, threat (2 bits) and
+// whether the entity was already seen at the previous turn. If so, its fields
+// are stored as deltas from that previous state, the position being predicted
+// as the previous position plus the previous velocity: a monster walking its
+// straight line costs 8 bytes per turn.
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+const char kReplayMagic[4] = { 'S', 'P', 'R', 'P' };
+const uint8_t kReplayVersion = 1;
+
+class ReplayWriter {
+public:
+    explicit ReplayWriter(std::ostream & os) : m_os(os), m_ours(), m_theirs() {}
+
+    void begin(const Point & base) {
+        m_buf.assign(kReplayMagic, kReplayMagic + sizeof(kReplayMagic));
+        m_buf.push_back(kReplayVersion);
+        put(base.x);
+        put(base.y);
+        flush();
+    }
+
+    void record(const Base & ours, const Base & theirs, const vector<Entity> & units) {
+        put_signed(ours.hp - m_ours.hp);
+        put_signed(ours.mp - m_ours.mp);
+        put_signed(theirs.hp - m_theirs.hp);
+        put_signed(theirs.mp - m_theirs.mp);
+        m_ours = ours;
+        m_theirs = theirs;
+
+        put(units.size());
+        int lastId = 0;
+        unordered_map<int, Entity> world;
+        for (const auto & e : units) {
+            put_signed(e.id - lastId);
+            lastId = e.id;
+
+            auto it = m_world.find(e.id);
+            bool seen = it != m_world.end();
+            Entity prev = seen ? it->second : Entity{};
+            if (seen) prev.pos += prev.v;
+            put(encode_flags(e, seen));
+            put_signed(e.pos.x - prev.pos.x);
+            put_signed(e.pos.y - prev.pos.y);
+            put_signed(e.shield - prev.shield);
+            put_signed(e.hp - prev.hp);
+            put_signed(e.v.x - prev.v.x);
+            put_signed(e.v.y - prev.v.y);
+            world[e.id] = e;
+        }
+        swap(m_world, world);
+        flush();
+    }
+
+private:
+    static unsigned encode_flags(const Entity & e, bool seen) {
+        return (e.type & 3) | (e.mad ? 4 : 0) | ((e.target & 1) << 3) | ((e.threat & 3) << 4) | (seen ? 64 : 0);
+    }
+
+    void put(uint64_t n) {
+        while (n >= 0x80) {
+            m_buf.push_back((uint8_t)(n | 0x80));
+            n >>= 7;
+        }
+        m_buf.push_back((uint8_t)n);
+    }
+
+    void put_signed(int64_t n) {
+        put(((uint64_t)n << 1) ^ (uint64_t)(n >> 63));
+    }
+
+    void flush() {
+        m_os.write((const char *)m_buf.data(), m_buf.size());
+        m_buf.clear();
+    }
+
+    std::ostream & m_os;
+    vector<uint8_t> m_buf;
+    Base m_ours;
+    Base m_theirs;
+    unordered_map<int, Entity> m_world; // the previous turn
+};
+
+class ReplayReader {
+public:
+    ReplayReader(const uint8_t * data, size_t size) :
+        m_cur(data), m_end(data + size), m_ok(true), m_base(), m_ours(), m_theirs()
+    {
+        if (size < sizeof(kReplayMagic) + 1 || memcmp(data, kReplayMagic, sizeof(kReplayMagic)) != 0) {
+            cerr << "Replay: bad magic" << endl;
+            m_ok = false;
+            return;
+        }
+        m_cur += sizeof(kReplayMagic);
+        if (*m_cur++ != kReplayVersion) {
+            cerr << "Replay: unsupported version" << endl;
+            m_ok = false;
+            return;
+        }
+        m_base.x = get();
+        m_base.y = get();
+    }
+
+    bool ok() const { return m_ok; }
+
+    // our base (the one of the recorded player)
+    const Point & base() const { return m_base; }
+
+    // decode the next turn; false at the end of the record (or on corruption)
+    bool next(Base & ours, Base & theirs, vector<Entity> & units) {
+        if (!m_ok || m_cur >= m_end) return false;
+
+        m_ours.hp += get_signed();
+        m_ours.mp += get_signed();
+        m_theirs.hp += get_signed();
+        m_theirs.mp += get_signed();
+        ours.update(m_ours.hp, m_ours.mp);
+        theirs.update(m_theirs.hp, m_theirs.mp);
+
+        int n = get();
+        units.clear();
+        int lastId = 0;
+        unordered_map<int, Entity> world;
+        for (int i = 0; i < n && m_ok; ++i) {
+            Entity e = {};
+            e.id = lastId + get_signed();
+            lastId = e.id;
+
+            unsigned flags = get();
+            Entity prev = {};
+            if (flags & 64) {
+                auto it = m_world.find(e.id);
+                if (it == m_world.end()) {
+                    cerr << "Replay: unknown entity " << e.id << endl;
+                    m_ok = false;
+                    break;
+                }
+                prev = it->second;
+                prev.pos += prev.v;
+            }
+            e.type = flags & 3;
+            e.mad = (flags & 4) != 0;
+            e.target = (flags >> 3) & 1;
+            e.threat = (flags >> 4) & 3;
+            e.pos.x = prev.pos.x + get_signed();
+            e.pos.y = prev.pos.y + get_signed();
+            e.shield = prev.shield + get_signed();
+            e.hp = prev.hp + get_signed();
+            e.v.x = prev.v.x + get_signed();
+            e.v.y = prev.v.y + get_signed();
+            units.push_back(e);
+            world[e.id] = e;
+        }
+        swap(m_world, world);
+        return m_ok;
+    }
+
+private:
+    uint64_t get() {
+        uint64_t n = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (m_cur >= m_end) break;
+            uint8_t byte = *m_cur++;
+            n |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return n;
+        }
+        cerr << "Replay: truncated record" << endl;
+        m_ok = false;
+        return 0;
+    }
+
+    int64_t get_signed() {
+        uint64_t n = get();
+        return (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+    }
+
+    const uint8_t * m_cur;
+    const uint8_t * m_end;
+    bool m_ok;
+    Point m_base;
+    Base m_ours;
+    Base m_theirs;
+    unordered_map<int, Entity> m_world; // the previous turn
+};
+
+#endif // REPLAY_H
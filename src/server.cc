@@ -0,0 +1,168 @@
+// Many concurrent games in a single process: one Brain per session, the sessions
+// being multiplexed over a single framed input.
+//
+// usage: server.out < frames
+//
+// Every frame starts with the id of its session and its kind, the rest being the
+// integers of the referee's protocol:
+//   0 (start): session 0 base_x base_y heroes_per_player
+//   1 (turn):  session 1 health mana health mana entity_count entity*
+//   2 (end):   session 2
+// A turn is answered by "session count" on a line, followed by the count commands
+// of the heros (one per line). A start frame for a live session starts a new game.
+//
+// The answers are written out once the input already read in has been handled,
+// so a batch of turns costs a single write and a peer waiting for an answer is
+// never kept waiting.
+
+#define BRAIN_NO_MAIN
+#include "game.cc"
+
+#include <unordered_map>
+
+enum FrameKind {
+    FrameStart,
+    FrameTurn,
+    FrameEnd,
+};
+
+struct Session {
+    Brain brain;
+    TurnInput input; // reused from one turn to the next
+
+    Session() {
+        brain.set_log(nullptr);
+        input.units.reserve(kMaxEntities);
+    }
+};
+
+class FrameWriter {
+public:
+    static constexpr size_t kFlushSize = 1 << 16;
+
+    explicit FrameWriter(int fd = 1) : m_fd(fd) {
+        m_buf.reserve(2 * kFlushSize);
+    }
+
+    void answer(int session, const TurnOutput & output) {
+        CommandLine header;
+        header << session << " " << output.count;
+        append(header);
+        for (int i = 0; i < output.count; ++i) {
+            append(output.lines[i]);
+        }
+        if (m_buf.size() >= kFlushSize) flush();
+    }
+
+    // false on a write error
+    bool flush() {
+        size_t done = 0;
+        while (done < m_buf.size()) {
+            ssize_t n = ::write(m_fd, m_buf.data() + done, m_buf.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += n;
+        }
+        m_buf.clear();
+        return true;
+    }
+
+private:
+    void append(const CommandLine & line) {
+        m_buf.append(line.c_str(), line.size());
+        m_buf.push_back('\n');
+    }
+
+    int m_fd;
+    string m_buf;
+};
+
+// false if the input ends within the turn
+bool read_turn(InputReader & in, TurnInput & input) {
+    int health = in.next();
+    int mana = in.next();
+    input.ours.update(health, mana);
+    health = in.next();
+    mana = in.next();
+    input.theirs.update(health, mana);
+
+    int entity_count = in.next();
+    input.units.clear();
+    for (int i = 0; i < entity_count && in.ok(); i++) {
+        Entity e;
+        e.id = in.next();
+        e.type = in.next();
+        e.pos.x = in.next();
+        e.pos.y = in.next();
+        e.shield = in.next();
+        e.mad = in.next() ? true : false;
+        e.hp = in.next();
+        e.v.x = in.next();
+        e.v.y = in.next();
+        e.target = in.next();
+        e.threat = in.next();
+        input.units.push_back(e);
+    }
+    return in.ok();
+}
+
+int main()
+{
+    InputReader in;
+    FrameWriter out;
+    unordered_map<int, std::unique_ptr<Session>> sessions;
+    TurnInput unknown;
+    long long turns = 0;
+    size_t peak = 0;
+
+    while (true) {
+        // nothing left to handle without waiting: the peers get their answers first
+        if (!in.buffered() && !out.flush()) {
+            cerr << "server: cannot write the answers" << endl;
+            return 1;
+        }
+
+        int id = in.next();
+        int kind = in.next();
+        if (!in.ok()) break;
+
+        switch (kind) {
+            case FrameStart: {
+                int base_x = in.next();
+                int base_y = in.next();
+                in.next(); // heroes_per_player
+                auto & session = sessions[id];
+                if (!session) session.reset(new Session());
+                session->brain.init(Point(base_x, base_y));
+                peak = std::max(peak, sessions.size());
+                break;
+            }
+
+            case FrameTurn: {
+                auto it = sessions.find(id);
+                if (it == sessions.end()) {
+                    // read all the same, the next frame is right after it
+                    read_turn(in, unknown);
+                    cerr << "server: turn for an unknown session " << id << endl;
+                    break;
+                }
+                auto & session = *it->second;
+                if (!read_turn(in, session.input)) break;
+                out.answer(id, session.brain.step(session.input));
+                ++turns;
+                break;
+            }
+
+            case FrameEnd:
+                sessions.erase(id);
+                break;
+
+            default:
+                cerr << "server: unknown frame " << kind << " (session " << id << ")" << endl;
+                return 1;
+        }
+    }
+    out.flush();
+    cerr << "server: " << turns << " turns; " << peak << " sessions at most" << endl;
+    return 0;
+}
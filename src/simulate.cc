@@ -0,0 +1,68 @@
+// Self-play of the bot on the offline referee.
+//
+// usage: simulate.out [games] [seed] [record_dir]
+//
+// Game i is played with the seed (seed + i), so any result can be replayed.
+// With a record_dir, both sides of game i are saved as binary replays
+// (<record_dir>/<seed + i>-blue.rpl and <record_dir>/<seed + i>-red.rpl).
+
+#define BRAIN_NO_MAIN
+#include "game.cc"
+#include "simulator.h"
+#include "replay.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+
+int main(int argc, char ** argv)
+{
+    int games = argc > 1 ? std::atoi(argv[1]) : 100;
+    uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+    string recordDir = argc > 3 ? argv[3] : "";
+
+    int wins[2] = { 0, 0 };
+    int draws = 0;
+    long long turns = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        for (int i = 0; i < games; ++i) {
+            Simulator sim(seed + i);
+            Brain blue = sim.make_brain(0);
+            Brain red = sim.make_brain(1);
+            // the brains are very talkative
+            blue.set_log(nullptr);
+            red.set_log(nullptr);
+
+            TurnObserver observer;
+            std::ofstream files[2];
+            vector<ReplayWriter> writers;
+            if (!recordDir.empty()) {
+                const char * sides[2] = { "-blue.rpl", "-red.rpl" };
+                for (int p = 0; p < 2; ++p) {
+                    files[p].open(recordDir + "/" + std::to_string(seed + i) + sides[p], std::ios::binary);
+                    writers.emplace_back(files[p]);
+                    writers[p].begin(sim.base(p).pos);
+                }
+                observer = [&](int p, const Base & ours, const Base & theirs, const vector<Entity> & units) {
+                    writers[p].record(ours, theirs, units);
+                };
+            }
+
+            int winner = play_game(sim, blue, red, observer);
+            if (winner < 0) {
+                ++draws;
+            } else {
+                ++wins[winner];
+            }
+            turns += sim.turns();
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    cout << "games=" << games << "; blue=" << wins[0] << "; red=" << wins[1] << "; draws=" << draws << endl;
+    cout << "turns=" << turns << "; elapsed=" << elapsed.count() << "s";
+    cout << "; turns/s=" << (long long)(turns / elapsed.count()) << endl;
+    return 0;
+}
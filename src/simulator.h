@@ -0,0 +1,460 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+// Offline referee for the Spider Attack rules.
+//
+// It must be included right after game.cc (compiled with BRAIN_NO_MAIN) so that
+// the game state is kept in the very same Point/Entity/Monster/Hero/Base types
+// the bot works with: no translation layer between the two.
+//
+// Player 0 is the blue side (base at the top-left corner) and player 1 is the
+// red side (base at the bottom-right corner). Inside the simulator the field
+// Entity::type of a hero is 1 for player 0 and 2 for player 1, and the field
+// Entity::threat of a monster is 1 for the base of player 0 and 2 for the base
+// of player 1. observe() translates both into the point of view of a player.
+
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*****************************************************************************
+ * Rules (referee only)
+ ****************************************************************************/
+const int kMaxTurns = 220;
+const int kBaseHp = 3;
+const int kWindPushDistance = 2200;
+const int kSpellRange = 2200; // SHIELD and CONTROL
+const int kShieldDuration = 12;
+const int kManaPerHit = 1;
+const int kSpawnPeriod = 3;
+const int kSpawnSpread = 4000; // around the middle of the top/bottom edges
+const int kMonsterInitialHp = 10;
+const int kFirstMonsterId = 2 * kHerosPerPlayer;
+
+// xorshift64*: tiny, fast and identical on every platform
+class Rng {
+public:
+    explicit Rng(uint64_t seed) : m_state(seed ? seed : 0x9E3779B97F4A7C15ull) {}
+
+    uint64_t next() {
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545F4914F6CDD1Dull;
+    }
+
+    // uniform in [low, high]
+    int between(int low, int high) {
+        return low + (int)(next() % (uint64_t)(high - low + 1));
+    }
+
+private:
+    uint64_t m_state;
+};
+
+Point clamp_to_map(const Point & p) {
+    return Point(std::min(std::max(p.x, 0), kWidth), std::min(std::max(p.y, 0), kHeight));
+}
+
+class Simulator {
+public:
+    explicit Simulator(uint64_t seed) : m_rng(seed) {
+        reset(seed);
+    }
+
+    void reset(uint64_t seed) {
+        m_rng = Rng(seed);
+        m_turns = 0;
+        m_nextId = kFirstMonsterId;
+        m_monsters.clear();
+        m_heros.clear();
+
+        m_bases[0].pos = Point(0, 0);
+        m_bases[1].pos = Point(kWidth, kHeight);
+        // the initial positions of the blue heros
+        const Point offsets[kHerosPerPlayer] = { Point(1414, 849), Point(1131, 1131), Point(849, 1414) };
+        for (int p = 0; p < 2; ++p) {
+            m_bases[p].update(kBaseHp, 0);
+            m_wildMana[p] = 0;
+            for (int i = 0; i < kHerosPerPlayer; ++i) {
+                Entity e = {};
+                e.id = p * kHerosPerPlayer + i;
+                e.type = p + 1;
+                e.pos = p == 0 ? offsets[i] : m_bases[1].pos - offsets[i];
+                m_heros.emplace_back(e);
+                m_orders[p][i] = Action();
+                m_controlled[p][i] = false;
+            }
+        }
+    }
+
+    int turns() const { return m_turns; }
+    const Base & base(int player) const { return m_bases[player]; }
+    int wildMana(int player) const { return m_wildMana[player]; }
+    const vector<Hero> & heros() const { return m_heros; }
+    const vector<Monster> & monsters() const { return m_monsters; }
+
+    // a fresh Brain playing for the given side
+    Brain make_brain(int player) const {
+        return Brain(m_bases[player], m_bases[1 - player]);
+    }
+
+    // everything the given player can see this turn (fog of war applied), sorted by id
+    vector<Entity> observe(int player) const {
+        vector<Entity> units;
+        for (const auto & h : m_heros) {
+            int owner = h.type - 1;
+            if (owner != player && !visible(player, h.pos)) continue;
+
+            Entity e = h;
+            e.type = owner == player ? 1 : 2;
+            units.push_back(e);
+        }
+        for (const auto & m : m_monsters) {
+            if (!visible(player, m.pos)) continue;
+
+            Entity e = m;
+            if (player == 1 && e.threat != 0) e.threat = 3 - e.threat;
+            units.push_back(e);
+        }
+        return units;
+    }
+
+    // the raw output of a player this turn: one line per hero, in the order of ids
+    void order(int player, const string & output) {
+        std::istringstream is(output);
+        string line;
+        for (int i = 0; i < kHerosPerPlayer; ++i) {
+            m_orders[player][i] = std::getline(is, line) ? parse_order(line) : Action();
+            m_orders[player][i].subject = i;
+        }
+    }
+
+    // the commands of a player this turn, as produced by Brain::step()
+    void order(int player, const TurnOutput & output) {
+        for (int i = 0; i < kHerosPerPlayer; ++i) {
+            Action a;
+            if (i < output.count) {
+                a.verb = output.orders[i].verb;
+                a.object = output.orders[i].object;
+                a.dest = output.orders[i].dest;
+            }
+            a.subject = i;
+            m_orders[player][i] = a;
+        }
+    }
+
+    void order(int player, int idx, const Action & a) {
+        m_orders[player][idx] = a;
+    }
+
+    // resolve one turn
+    void step() {
+        ++m_turns;
+
+        // controlled heros follow the orders of the opponent
+        for (int p = 0; p < 2; ++p) {
+            for (int i = 0; i < kHerosPerPlayer; ++i) {
+                if (!m_controlled[p][i]) continue;
+
+                m_orders[p][i].verb = MOVE;
+                m_orders[p][i].dest = m_forced[p][i];
+                m_controlled[p][i] = false;
+            }
+        }
+
+        vector<bool> pushed(m_monsters.size(), false);
+        cast_spells(pushed);
+        move_heros();
+        attack_monsters();
+        move_monsters(pushed);
+        expire_effects();
+        spawn_monsters();
+        update_threats();
+
+        for (int p = 0; p < 2; ++p) {
+            for (int i = 0; i < kHerosPerPlayer; ++i) {
+                m_orders[p][i] = Action();
+            }
+        }
+    }
+
+    bool over() const {
+        return m_turns >= kMaxTurns || m_bases[0].hp <= 0 || m_bases[1].hp <= 0;
+    }
+
+    // 0 or 1 for the winner, -1 for a draw
+    int winner() const {
+        if (m_bases[0].hp != m_bases[1].hp) return m_bases[0].hp > m_bases[1].hp ? 0 : 1;
+        if (m_wildMana[0] != m_wildMana[1]) return m_wildMana[0] > m_wildMana[1] ? 0 : 1;
+        return -1;
+    }
+
+private:
+    static Action parse_order(const string & line) {
+        std::istringstream is(line);
+        string word;
+        Action a;
+        is >> word;
+        if (word == "MOVE") {
+            a.verb = MOVE;
+            is >> a.dest.x >> a.dest.y;
+        } else if (word == "SPELL") {
+            is >> word;
+            if (word == "WIND") {
+                a.verb = WIND;
+                is >> a.dest.x >> a.dest.y;
+            } else if (word == "SHIELD") {
+                a.verb = PROTECT;
+                is >> a.object;
+            } else if (word == "CONTROL") {
+                a.verb = CONTROL;
+                is >> a.object >> a.dest.x >> a.dest.y;
+            } else {
+                cerr << "Referee: unknown spell: " << line << endl;
+            }
+        } else if (word != "WAIT") {
+            cerr << "Referee: unknown command: " << line << endl;
+        }
+        if (is.fail()) {
+            cerr << "Referee: malformed command: " << line << endl;
+            return Action();
+        }
+        return a;
+    }
+
+    Hero & hero(int player, int idx) {
+        return m_heros[player * kHerosPerPlayer + idx];
+    }
+
+    bool visible(int player, const Point & pos) const {
+        if (distance(pos, m_bases[player].pos) <= kBaseViewRange) return true;
+        for (int i = 0; i < kHerosPerPlayer; ++i) {
+            if (distance(pos, m_heros[player * kHerosPerPlayer + i].pos) <= kHeroViewRange) return true;
+        }
+        return false;
+    }
+
+    // nullptr if the entity is gone
+    Entity * find(int id) {
+        if (id >= 0 && id < kFirstMonsterId) return &m_heros[id];
+        for (auto & m : m_monsters) {
+            if (m.id == id) return &m;
+        }
+        return nullptr;
+    }
+
+    void cast_spells(vector<bool> & pushed) {
+        for (int p = 0; p < 2; ++p) {
+            for (int i = 0; i < kHerosPerPlayer; ++i) {
+                auto & a = m_orders[p][i];
+                if (a.verb != WIND && a.verb != PROTECT && a.verb != CONTROL) continue;
+                if (m_bases[p].mp < kMagicManaCost) {
+                    a.verb = WAIT;
+                    continue;
+                }
+                m_bases[p].mp -= kMagicManaCost;
+
+                auto & caster = hero(p, i);
+                if (a.verb == WIND) {
+                    blow(p, caster.pos, a.dest, pushed);
+                    continue;
+                }
+
+                Entity * target = find(a.object);
+                if (target == nullptr || target->shield > 0) continue;
+                if (distance(caster.pos, target->pos) > kSpellRange) continue;
+
+                if (a.verb == PROTECT) {
+                    target->shield = kShieldDuration;
+                } else if (target->type == 0) {
+                    Point v = scale_toward(target->pos, a.dest, kMonsterSpeed);
+                    if (v.x != 0 || v.y != 0) target->v = v;
+                    target->target = 0;
+                    target->mad = true;
+                } else if (target->type != p + 1) {
+                    int owner = target->type - 1;
+                    int idx = target->id - owner * kHerosPerPlayer;
+                    m_controlled[owner][idx] = true;
+                    m_forced[owner][idx] = a.dest;
+                    target->mad = true;
+                }
+            }
+        }
+    }
+
+    // push the monsters and the opponents around the caster
+    void blow(int player, const Point & from, const Point & toward, vector<bool> & pushed) {
+        Point push = scale_toward(from, toward, kWindPushDistance);
+        for (int i = 0; i < (int) m_monsters.size(); ++i) {
+            auto & m = m_monsters[i];
+            if (m.shield > 0 || distance(m.pos, from) > kRadiusOfWind) continue;
+
+            m.pos += push;
+            pushed[i] = true;
+        }
+        for (auto & h : m_heros) {
+            if (h.type == player + 1 || h.shield > 0) continue;
+            if (distance(h.pos, from) > kRadiusOfWind) continue;
+
+            h.pos = clamp_to_map(h.pos + push);
+        }
+    }
+
+    void move_heros() {
+        for (int p = 0; p < 2; ++p) {
+            for (int i = 0; i < kHerosPerPlayer; ++i) {
+                const auto & a = m_orders[p][i];
+                if (a.verb != MOVE) continue;
+
+                auto & h = hero(p, i);
+                if (distance(h.pos, a.dest) <= kHeroSpeed) {
+                    h.pos = clamp_to_map(a.dest);
+                } else {
+                    h.pos = clamp_to_map(h.pos + scale_toward(h.pos, a.dest, kHeroSpeed));
+                }
+            }
+        }
+    }
+
+    void attack_monsters() {
+        for (const auto & h : m_heros) {
+            int p = h.type - 1;
+            for (auto & m : m_monsters) {
+                if (distance(h.pos, m.pos) > kHeroPhysicAttackRange) continue;
+
+                m.hp -= kHeroPhysicAttackDmg;
+                m_bases[p].mp += kManaPerHit;
+                if (distance(m.pos, m_bases[p].pos) > kRadiusOfBase) {
+                    m_wildMana[p] += kManaPerHit;
+                }
+            }
+        }
+    }
+
+    void move_monsters(const vector<bool> & pushed) {
+        vector<Monster> survivors;
+        for (int i = 0; i < (int) m_monsters.size(); ++i) {
+            auto & m = m_monsters[i];
+            if (m.hp <= 0) continue;
+
+            if (m.target != 0 && !pushed[i]) {
+                auto & base = m_bases[m.threat - 1];
+                if (distance(m.pos, base.pos) <= kMonsterSpeed) {
+                    m.pos = base.pos;
+                } else {
+                    m.pos += scale_toward(m.pos, base.pos, kMonsterSpeed);
+                }
+                if (distance(m.pos, base.pos) <= kBaseAttackRange) {
+                    --base.hp;
+                    continue;
+                }
+            } else if (!pushed[i]) {
+                m.pos += m.v;
+            }
+            // wander off (or blown off) the map
+            if (!m.pos.valid()) continue;
+
+            if (m.target != 0 && distance(m.pos, m_bases[m.threat - 1].pos) > kRadiusOfBase) {
+                m.target = 0;
+            }
+            if (m.target == 0 && !m.mad) {
+                for (int p = 0; p < 2; ++p) {
+                    if (distance(m.pos, m_bases[p].pos) > kRadiusOfBase) continue;
+
+                    m.target = 1;
+                    m.threat = p + 1;
+                    m.v = scale_toward(m.pos, m_bases[p].pos, kMonsterSpeed);
+                    break;
+                }
+            }
+            survivors.push_back(m);
+        }
+        swap(m_monsters, survivors);
+    }
+
+    void expire_effects() {
+        for (auto & h : m_heros) {
+            if (h.shield > 0) --h.shield;
+            int owner = h.type - 1;
+            h.mad = m_controlled[owner][h.id - owner * kHerosPerPlayer];
+        }
+        for (auto & m : m_monsters) {
+            if (m.shield > 0) --m.shield;
+            m.mad = false;
+        }
+    }
+
+    // monsters come in symmetric pairs from the top and the bottom edges
+    void spawn_monsters() {
+        if ((m_turns - 1) % kSpawnPeriod != 0) return;
+
+        Entity e = {};
+        e.type = 0;
+        e.hp = kMonsterInitialHp + m_turns / 10;
+        e.pos = Point(m_rng.between(kWidth / 2 - kSpawnSpread, kWidth / 2 + kSpawnSpread), 0);
+        double theta = convert_degree_to_radian(m_rng.between(20, 160));
+        e.v = Point(kMonsterSpeed * std::cos(theta), kMonsterSpeed * std::sin(theta));
+
+        e.id = m_nextId++;
+        m_monsters.emplace_back(e);
+
+        e.id = m_nextId++;
+        e.pos = Point(kWidth - e.pos.x, kHeight - e.pos.y);
+        e.v = Point(-e.v.x, -e.v.y);
+        m_monsters.emplace_back(e);
+    }
+
+    void update_threats() {
+        for (auto & m : m_monsters) {
+            if (m.target != 0) continue;
+
+            if (m.eta(m_bases[0]) >= 0) {
+                m.threat = 1;
+            } else if (m.eta(m_bases[1]) >= 0) {
+                m.threat = 2;
+            } else {
+                m.threat = 0;
+            }
+        }
+    }
+
+    Rng m_rng;
+    int m_turns;
+    int m_nextId;
+    Base m_bases[2];
+    int m_wildMana[2];
+
+    vector<Hero> m_heros; // ordered by id
+    vector<Monster> m_monsters; // ordered by id
+
+    Action m_orders[2][kHerosPerPlayer];
+    bool m_controlled[2][kHerosPerPlayer];
+    Point m_forced[2][kHerosPerPlayer];
+};
+
+// Called with what a player sees at the beginning of each turn
+using TurnObserver = std::function<void(int player, const Base & ours, const Base & theirs,
+                                        const vector<Entity> & units)>;
+
+// Play a whole game between two brains and produce the winner (0, 1 or -1 for a draw).
+int play_game(Simulator & sim, Brain & blue, Brain & red, const TurnObserver & observer = nullptr) {
+    Brain * brains[2] = { &blue, &red };
+    TurnInput input;
+
+    while (!sim.over()) {
+        for (int p = 0; p < 2; ++p) {
+            input.ours = sim.base(p);
+            input.theirs = sim.base(1 - p);
+            input.units = sim.observe(p);
+            if (observer) observer(p, input.ours, input.theirs, input.units);
+            sim.order(p, brains[p]->step(input));
+        }
+        sim.step();
+    }
+    return sim.winner();
+}
+
+#endif // SIMULATOR_H
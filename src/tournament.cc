@@ -0,0 +1,451 @@
+// Tournament between two variants of the bot on the offline referee, over all the cores.
+//
+// usage: tournament.out [options] A B
+//
+// A and B are either a set of parameters (BrainParams) given as name=value pairs
+// separated by commas ("default" for none), played in-process, or the path of a
+// server (server.out) of another build, played through its framed input.
+//
+//   -j threads   the workers (all the cores by default)
+//   -n games     at most (20000 by default)
+//   -s seed      of the first pair of games (1 by default)
+//   -e elo0 elo1 the hypotheses of the SPRT, for A against B (0 and 5 by default)
+//   -a alpha     the error rates of the SPRT (0.05 by default, for both)
+//
+// The games go by pairs on the same seed, A playing the blue side then the red one.
+// The workers take the pairs one at a time, so a slow game never holds the others back.
+// The tournament stops as soon as the sequential probability ratio test accepts one
+// of the hypotheses (A is elo0 or elo1 stronger than B), or after the last game.
+//
+// e.g. tournament.out endingMaxHp=26,middleMana=150 default
+
+#define BRAIN_NO_MAIN
+#include "game.cc"
+#include "simulator.h"
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <mutex>
+#include <thread>
+
+#include <sys/wait.h>
+
+// the parameters that can be set on the command line
+const struct {
+    const char * name;
+    int BrainParams::* field;
+} kParams[] = {
+    { "endingMaxHp", &BrainParams::endingMaxHp },
+    { "middleMaxHp", &BrainParams::middleMaxHp },
+    { "middleMana", &BrainParams::middleMana },
+    { "shieldEta", &BrainParams::shieldEta },
+};
+
+// false on an unknown name or a malformed value
+bool parse_params(const string & text, BrainParams & params) {
+    if (text == "default") return true;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(',', start);
+        if (end == string::npos) end = text.size();
+        string item = text.substr(start, end - start);
+        size_t eq = item.find('=');
+        if (eq == string::npos) return false;
+        string name = item.substr(0, eq);
+        char * last = nullptr;
+        long value = std::strtol(item.c_str() + eq + 1, &last, 10);
+        if (last == item.c_str() + eq + 1 || *last != '\0') return false;
+
+        bool known = false;
+        for (const auto & p : kParams) {
+            if (name == p.name) {
+                params.*p.field = (int) value;
+                known = true;
+            }
+        }
+        if (!known) return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+// The bot of another build behind its server: a session per side
+class RemoteBrain {
+public:
+    explicit RemoteBrain(const string & path) : m_pid(-1), m_in(-1), m_out(-1), m_cur(m_buf), m_end(m_buf) {
+        int toServer[2], fromServer[2];
+        if (pipe(toServer) != 0) return;
+        if (pipe(fromServer) != 0) {
+            close(toServer[0]);
+            close(toServer[1]);
+            return;
+        }
+        m_pid = fork();
+        if (m_pid == 0) {
+            dup2(toServer[0], 0);
+            dup2(fromServer[1], 1);
+            close(toServer[0]);
+            close(toServer[1]);
+            close(fromServer[0]);
+            close(fromServer[1]);
+            execl(path.c_str(), path.c_str(), (char *) nullptr);
+            _exit(127);
+        }
+        close(toServer[0]);
+        close(fromServer[1]);
+        m_out = toServer[1];
+        m_in = fromServer[0];
+        if (m_pid < 0) {
+            close(m_out);
+            close(m_in);
+            m_out = m_in = -1;
+        }
+    }
+
+    ~RemoteBrain() {
+        if (m_out >= 0) close(m_out);
+        if (m_in >= 0) close(m_in);
+        if (m_pid > 0) waitpid(m_pid, nullptr, 0);
+    }
+
+    RemoteBrain(const RemoteBrain &) = delete;
+    RemoteBrain & operator=(const RemoteBrain &) = delete;
+
+    bool ok() const { return m_pid > 0; }
+
+    bool init(int session, const Point & base) {
+        m_frame.clear();
+        m_frame << session << " " << FrameStart << " " << base.x << " " << base.y << " " << kHerosPerPlayer << "\n";
+        return send();
+    }
+
+    // the raw commands of the heros, one per line
+    bool step(int session, const TurnInput & input, string & commands) {
+        m_frame.clear();
+        m_frame << session << " " << FrameTurn << " " << input.ours.hp << " " << input.ours.mp << " ";
+        m_frame << input.theirs.hp << " " << input.theirs.mp << " " << input.units.size() << "\n";
+        for (const auto & e : input.units) {
+            m_frame << e.id << " " << e.type << " " << e.pos.x << " " << e.pos.y << " " << e.shield << " ";
+            m_frame << (int) e.mad << " " << e.hp << " " << e.v.x << " " << e.v.y << " " << e.target << " ";
+            m_frame << e.threat << "\n";
+        }
+        if (!send()) return false;
+
+        string line;
+        if (!read_line(line)) return false;
+        int id = 0, count = 0;
+        if (sscanf(line.c_str(), "%d %d", &id, &count) != 2 || id != session) return false;
+        commands.clear();
+        for (int i = 0; i < count; ++i) {
+            if (!read_line(line)) return false;
+            commands += line;
+            commands += '\n';
+        }
+        return true;
+    }
+
+private:
+    // the kinds of frames of server.cc
+    enum { FrameStart = 0, FrameTurn = 1 };
+
+    // a frame being built
+    class TextFrame {
+    public:
+        void clear() { m_text.clear(); }
+        const string & text() const { return m_text; }
+
+        template <typename T>
+        TextFrame & operator<<(const T & value) {
+            m_text += to_text(value);
+            return *this;
+        }
+
+    private:
+        static string to_text(const char * s) { return s; }
+        static string to_text(long long n) { return std::to_string(n); }
+
+        string m_text;
+    };
+
+    bool send() {
+        const string & text = m_frame.text();
+        size_t done = 0;
+        while (done < text.size()) {
+            ssize_t n = ::write(m_out, text.data() + done, text.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += n;
+        }
+        return true;
+    }
+
+    bool read_line(string & line) {
+        line.clear();
+        while (true) {
+            if (m_cur == m_end) {
+                ssize_t n;
+                do {
+                    n = ::read(m_in, m_buf, sizeof(m_buf));
+                } while (n < 0 && errno == EINTR);
+                if (n <= 0) return false;
+                m_cur = m_buf;
+                m_end = m_buf + n;
+            }
+            char c = *m_cur++;
+            if (c == '\n') return true;
+            line.push_back(c);
+        }
+    }
+
+    pid_t m_pid;
+    int m_in; // the answers of the server
+    int m_out; // its input
+    TextFrame m_frame;
+    char m_buf[1 << 12];
+    const char * m_cur;
+    const char * m_end;
+};
+
+// One of the two variants, as played by a worker
+class Player {
+public:
+    // an empty path for the in-process bot
+    Player(const BrainParams & params, const string & path) {
+        m_brains[0].set_log(nullptr);
+        m_brains[1].set_log(nullptr);
+        m_brains[0].set_params(params);
+        m_brains[1].set_params(params);
+        if (!path.empty()) m_remote.reset(new RemoteBrain(path));
+    }
+
+    bool ok() const { return !m_remote || m_remote->ok(); }
+
+    // a new game, on the given side
+    bool start(int side, const Point & base) {
+        if (m_remote) return m_remote->init(side, base);
+        m_brains[side].init(base);
+        return true;
+    }
+
+    bool play(Simulator & sim, int side, const TurnInput & input) {
+        if (!m_remote) {
+            sim.order(side, m_brains[side].step(input));
+            return true;
+        }
+        if (!m_remote->step(side, input, m_commands)) return false;
+        sim.order(side, m_commands);
+        return true;
+    }
+
+private:
+    Brain m_brains[2]; // by side
+    std::unique_ptr<RemoteBrain> m_remote;
+    string m_commands;
+};
+
+// The sequential probability ratio test on the score of A (1 a win, 0.5 a draw), with
+// the usual normal approximation of its log-likelihood ratio
+class Sprt {
+public:
+    Sprt(double elo0, double elo1, double alpha, double beta) :
+        m_s0(score_of(elo0)), m_s1(score_of(elo1)),
+        m_lower(std::log(beta / (1 - alpha))), m_upper(std::log((1 - beta) / alpha)),
+        m_wins(0), m_losses(0), m_draws(0)
+    {
+    }
+
+    void add(int wins, int losses, int draws) {
+        m_wins += wins;
+        m_losses += losses;
+        m_draws += draws;
+    }
+
+    int games() const { return m_wins + m_losses + m_draws; }
+    int wins() const { return m_wins; }
+    int losses() const { return m_losses; }
+    int draws() const { return m_draws; }
+
+    double score() const {
+        return games() == 0 ? 0.5 : (m_wins + 0.5 * m_draws) / games();
+    }
+
+    // the variance of the score of a game
+    double variance() const {
+        if (games() == 0) return 0;
+        double s = score();
+        return (m_wins * square(1 - s) + m_draws * square(0.5 - s) + m_losses * square(s)) / games();
+    }
+
+    double llr() const {
+        double var = variance();
+        if (var <= 0) return 0;
+        double s = score();
+        return games() * (square(s - m_s0) - square(s - m_s1)) / (2 * var);
+    }
+
+    double lower() const { return m_lower; }
+    double upper() const { return m_upper; }
+
+    // -1 for H0 (elo0), 1 for H1 (elo1), 0 while still open
+    int verdict() const {
+        double r = llr();
+        return r <= m_lower ? -1 : r >= m_upper ? 1 : 0;
+    }
+
+    static double score_of(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); }
+
+    static double elo_of(double score) {
+        score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+        return -400 * std::log10(1 / score - 1);
+    }
+
+private:
+    static double square(double x) { return x * x; }
+
+    double m_s0;
+    double m_s1;
+    double m_lower;
+    double m_upper;
+    int m_wins;
+    int m_losses;
+    int m_draws;
+};
+
+struct Variant {
+    string name;
+    BrainParams params;
+    string path; // of a server (empty for the in-process bot)
+};
+
+// false if the argument is neither a server nor a valid set of parameters
+bool parse_variant(const string & arg, Variant & v) {
+    v.name = arg;
+    if (access(arg.c_str(), X_OK) == 0) {
+        v.path = arg;
+        return true;
+    }
+    return parse_params(arg, v.params);
+}
+
+int main(int argc, char ** argv)
+{
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int maxGames = 20000;
+    uint64_t seed = 1;
+    double elo0 = 0, elo1 = 5, alpha = 0.05;
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (a == "-j" && i + 1 < argc) {
+            threads = std::max(1, std::atoi(argv[++i]));
+        } else if (a == "-n" && i + 1 < argc) {
+            maxGames = std::atoi(argv[++i]);
+        } else if (a == "-s" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (a == "-e" && i + 2 < argc) {
+            elo0 = std::atof(argv[++i]);
+            elo1 = std::atof(argv[++i]);
+        } else if (a == "-a" && i + 1 < argc) {
+            alpha = std::atof(argv[++i]);
+        } else {
+            args.push_back(a);
+        }
+    }
+    Variant variants[2];
+    if (args.size() != 2 || !parse_variant(args[0], variants[0]) || !parse_variant(args[1], variants[1])) {
+        cerr << "usage: " << argv[0] << " [-j threads] [-n games] [-s seed] [-e elo0 elo1] [-a alpha] A B" << endl;
+        cerr << "  A, B: default, name=value[,name=value...] or the path of a server.out; the names:";
+        for (const auto & p : kParams) cerr << " " << p.name;
+        cerr << endl;
+        return 1;
+    }
+    // a server gone is seen by a failing write
+    std::signal(SIGPIPE, SIG_IGN);
+
+    Sprt sprt(elo0, elo1, alpha, alpha);
+    std::mutex mutex; // over sprt
+    std::atomic<int> nextPair(0);
+    std::atomic<bool> stop(false);
+    std::atomic<bool> failed(false);
+    int pairs = (maxGames + 1) / 2;
+
+    auto worker = [&]() {
+        Player players[2] = {
+            Player(variants[0].params, variants[0].path),
+            Player(variants[1].params, variants[1].path),
+        };
+        if (!players[0].ok() || !players[1].ok()) {
+            failed = true;
+            stop = true;
+            return;
+        }
+        TurnInput input;
+        input.units.reserve(kMaxEntities);
+        while (!stop) {
+            int pair = nextPair++;
+            if (pair >= pairs) break;
+
+            int results[3] = { 0, 0, 0 }; // wins, losses, draws of A
+            for (int blue = 0; blue < 2; ++blue) {
+                // blue: the variant on the blue side
+                Player * sides[2] = { &players[blue], &players[1 - blue] };
+                Simulator sim(seed + pair);
+                bool ok = sides[0]->start(0, sim.base(0).pos) && sides[1]->start(1, sim.base(1).pos);
+                while (ok && !sim.over()) {
+                    for (int p = 0; p < 2 && ok; ++p) {
+                        input.ours = sim.base(p);
+                        input.theirs = sim.base(1 - p);
+                        input.units = sim.observe(p);
+                        ok = sides[p]->play(sim, p, input);
+                    }
+                    sim.step();
+                }
+                if (!ok) {
+                    failed = true;
+                    stop = true;
+                    return;
+                }
+                int winner = sim.winner();
+                if (winner < 0) {
+                    ++results[2];
+                } else {
+                    // A is on the blue side in the first game
+                    ++results[(winner == 0) == (blue == 0) ? 0 : 1];
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            sprt.add(results[0], results[1], results[2]);
+            if (sprt.verdict() != 0) stop = true;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto & w : workers) {
+        w.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (failed) {
+        cerr << "tournament: a server failed (is it a server.out?)" << endl;
+        return 1;
+    }
+
+    // the 95% interval of the elo difference
+    double s = sprt.score();
+    double margin = sprt.games() ? 1.96 * std::sqrt(sprt.variance() / sprt.games()) : 0;
+    int verdict = sprt.verdict();
+    cout << "A=" << variants[0].name << "; B=" << variants[1].name << endl;
+    cout << "games=" << sprt.games() << "; wins=" << sprt.wins() << "; losses=" << sprt.losses();
+    cout << "; draws=" << sprt.draws() << "; score=" << s << endl;
+    cout << "elo=" << Sprt::elo_of(s) << " [" << Sprt::elo_of(s - margin) << ", " << Sprt::elo_of(s + margin) << "]";
+    cout << "; llr=" << sprt.llr() << " [" << sprt.lower() << ", " << sprt.upper() << "]";
+    cout << "; sprt=" << (verdict > 0 ? "H1" : verdict < 0 ? "H0" : "open") << endl;
+    cout << "threads=" << threads << "; elapsed=" << elapsed.count() << "s";
+    cout << "; games/min=" << (long long)(sprt.games() * 60 / elapsed.count()) << endl;
+    return 0;
+}